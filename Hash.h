@@ -0,0 +1,137 @@
+/**
+ * 暗号用途ではないハッシュ
+ * Hash64 (FNV-1a) は解析設定や行の内容、Hash128 は元のテキスト全体と解析結果の構造に使う
+ */
+#ifndef __HASH_H__
+#define __HASH_H__
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+#include "tp_stub.h"
+
+class Hash64 {
+	tjs_uint64 Value = 14695981039346656037ULL;
+
+	void updateByte( tjs_uint8 b ) {
+		Value ^= b;
+		Value *= 1099511628211ULL;
+	}
+
+public:
+	/** 文字列を追加する */
+	void Update( const tjs_char* str, tjs_int len ) {
+		for( tjs_int i = 0; i < len; i++ ) {
+			tjs_uint32 c = static_cast<tjs_uint32>( str[i] );
+			updateByte( static_cast<tjs_uint8>( c & 0xff ) );
+			updateByte( static_cast<tjs_uint8>( ( c >> 8 ) & 0xff ) );
+		}
+	}
+	void Update( const ttstr& str ) {
+		Update( str.c_str(), str.GetLen() );
+		// 区切りを入れて "ab","c" と "a","bc" を区別する
+		Update( static_cast<tjs_uint64>( str.GetLen() ) );
+	}
+	/** 整数を追加する */
+	void Update( tjs_uint64 v ) {
+		for( int i = 0; i < 8; i++ ) {
+			updateByte( static_cast<tjs_uint8>( ( v >> ( i * 8 ) ) & 0xff ) );
+		}
+	}
+	tjs_uint64 Get() const { return Value; }
+};
+
+/** Hash128 の結果 */
+struct Hash128Value {
+	tjs_uint64 Low;		// 64bit だけ使う時はこちら
+	tjs_uint64 High;
+
+	bool operator==( const Hash128Value& rhs ) const { return Low == rhs.Low && High == rhs.High; }
+	bool operator!=( const Hash128Value& rhs ) const { return !( *this == rhs ); }
+};
+
+/**
+ * 暗号用途ではない 128bit ハッシュ
+ * 16bit の文字を4つずつ 64bit にまとめ、2系統に交互に混ぜる。1文字ずつ処理する Hash64 より速い
+ * 文字の値から語を作るので、実行環境のバイト順によらない
+ * 分けて Update しても、つなげて1度に Update した時と同じ値になる
+ */
+class Hash128 {
+	static const tjs_uint64 Prime1 = 0x9E3779B185EBCA87ULL;
+	static const tjs_uint64 Prime2 = 0xC2B2AE3D27D4EB4FULL;
+	static const tjs_uint64 Prime3 = 0x165667B19E3779F9ULL;
+
+	tjs_uint64 Lane[2] = { Prime1, Prime2 };
+	tjs_uint64 Words = 0;		// 混ぜた語の数
+	tjs_uint64 Pending = 0;		// 語にまとめる途中の文字
+	tjs_uint32 PendingCount = 0;
+
+	static tjs_uint64 rotl( tjs_uint64 v, int n ) {
+		return ( v << n ) | ( v >> ( 64 - n ) );
+	}
+	static tjs_uint64 mix( tjs_uint64 v ) {
+		v ^= v >> 33;
+		v *= 0xFF51AFD7ED558CCDULL;
+		v ^= v >> 33;
+		v *= 0xC4CEB9FE1A85EC53ULL;
+		v ^= v >> 33;
+		return v;
+	}
+	void updateWord( tjs_uint64 word ) {
+		tjs_uint64& lane = Lane[Words & 1];
+		lane += word * Prime2;
+		lane = rotl( lane, 31 );
+		lane *= Prime1;
+		Words++;
+	}
+	void updateUnit( tjs_uint32 c ) {
+		Pending |= static_cast<tjs_uint64>( c & 0xffff ) << ( PendingCount * 16 );
+		if( ++PendingCount == 4 ) {
+			updateWord( Pending );
+			Pending = 0;
+			PendingCount = 0;
+		}
+	}
+
+public:
+	/** 文字列を追加する */
+	void Update( const tjs_char* str, tjs_int len ) {
+		tjs_int i = 0;
+		while( i < len && PendingCount ) updateUnit( static_cast<tjs_uint32>( str[i++] ) );
+		for( ; i + 4 <= len; i += 4 ) {
+			tjs_uint64 word = static_cast<tjs_uint64>( static_cast<tjs_uint32>( str[i] ) & 0xffff )
+				| ( static_cast<tjs_uint64>( static_cast<tjs_uint32>( str[i + 1] ) & 0xffff ) << 16 )
+				| ( static_cast<tjs_uint64>( static_cast<tjs_uint32>( str[i + 2] ) & 0xffff ) << 32 )
+				| ( static_cast<tjs_uint64>( static_cast<tjs_uint32>( str[i + 3] ) & 0xffff ) << 48 );
+			updateWord( word );
+		}
+		while( i < len ) updateUnit( static_cast<tjs_uint32>( str[i++] ) );
+	}
+	void Update( const ttstr& str ) {
+		Update( str.c_str(), str.GetLen() );
+		// 区切りを入れて "ab","c" と "a","bc" を区別する
+		Update( static_cast<tjs_uint64>( str.GetLen() ) );
+	}
+	/** 整数を追加する */
+	void Update( tjs_uint64 v ) {
+		for( int i = 0; i < 4; i++ ) {
+			updateUnit( static_cast<tjs_uint32>( ( v >> ( i * 16 ) ) & 0xffff ) );
+		}
+	}
+	Hash128Value Get() const {
+		tjs_uint64 a = Lane[0];
+		tjs_uint64 b = Lane[1];
+		// 語にならなかった残りの文字と長さを混ぜる
+		if( PendingCount ) {
+			b += ( Pending ^ PendingCount ) * Prime3;
+			b = rotl( b, 27 ) * Prime1;
+		}
+		a ^= ( Words * 4 + PendingCount ) * Prime3;
+		Hash128Value result;
+		result.Low = mix( a + rotl( b, 17 ) );
+		result.High = mix( b ^ rotl( a, 41 ) ^ result.Low );
+		return result;
+	}
+};
+
+#endif // __HASH_H__
@@ -1592,7 +1592,7 @@ Token LexicalAnalyzer::GetInTagToken(tjs_int &n) {
 	BareWord = false;
 	if(retnum == Token::EMPTY) {
 		// not a reserved word
-		n = PutValue(str);
+		n = PutValue(Block->InternString(str));
 		return Token::SYMBOL;
 	}
 
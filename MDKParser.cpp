@@ -2,10 +2,19 @@
 
 #include "MDKParser.h"
 #include "Parser.h"
+#include "ScenarioBinary.h"
+#include "ScenarioImage.h"
+#include "ScenarioJson.h"
+#include "ScenarioBundle.h"
+#include "MappedFile.h"
+#include "ScenarioCache.h"
+#include "ReservedWord.h"
+#include <vector>
+#include <algorithm>
 
 //---------------------------------------------------------------------------
 tTJSNI_MDKParser::tTJSNI_MDKParser()
-	: Script( new Parser() ) {
+	: Script( new Parser() ), Cache( new ScenarioCache() ) {
 	Script->Initialize();
 }
 //---------------------------------------------------------------------------
@@ -21,27 +30,493 @@ tjs_error TJS_INTF_METHOD tTJSNI_MDKParser::Construct(tjs_int numparams, tTJSVar
 }
 //---------------------------------------------------------------------------
 void TJS_INTF_METHOD tTJSNI_MDKParser::Invalidate() {
+	if( Script->GetOption().SharedTags ) Script->GetOption().SharedTags->Clear();
+	Script->ClearStringPool();
+	Cache->Purge();
+	Bundle.reset();
+	Documents.clear();
 	Owner = nullptr;
 	inherited::Invalidate();
 }
 //---------------------------------------------------------------------------
-iTJSDispatch2 * tTJSNI_MDKParser::ParseMDKScenario( const ttstr& storage ) {
-//	Script->SetText()
-	iTJSDispatch2 *result = nullptr;
+void tTJSNI_MDKParser::ReadScenarioText( const ttstr& storage, ttstr& text ) {
 	iTJSTextReadStream * stream = nullptr;
 	try {
 		stream = TVPCreateTextStreamForRead( storage, TJS_W( "" ) );
-		ttstr tmp;
 		if( stream ) {
-			stream->Read( tmp, 0 );
+			stream->Read( text, 0 );
 		}
-		const tjs_char* buffer = tmp.c_str();
-		result = Script->ParseText( buffer );
 	} catch( ... ) {
 		if( stream ) stream->Destruct();
 		throw;
 	}
 	if( stream ) stream->Destruct();
+}
+//---------------------------------------------------------------------------
+std::shared_ptr<const ScenarioData> tTJSNI_MDKParser::LoadCompiledScenario( const ttstr& storage, tjs_uint64 sourceHash ) {
+	std::shared_ptr<MappedFile> file;
+	try {
+		file = MappedFile::Open( ScenarioBinary::GetCompiledName( storage ) );
+	} catch( ... ) {
+		// 読めない時は元のテキストを解析する
+		return nullptr;
+	}
+	if( !file ) return nullptr;
+
+	if( ScenarioImage::IsImage( file->GetData(), file->GetSize() ) ) {
+		// イメージはマップしたまま参照する
+		return ScenarioImage::Open( file, file->GetData(), file->GetSize(), sourceHash, Script->GetSettingsHash() );
+	}
+	return Script->LoadCompiled( file->GetData(), file->GetSize(), sourceHash );
+}
+//---------------------------------------------------------------------------
+std::shared_ptr<const ScenarioData> tTJSNI_MDKParser::LoadScenarioData( const ttstr& storage ) {
+	ttstr text;
+	ReadScenarioText( storage, text );
+	// キャッシュを引くのに解析前に求める。解析時にはこの値を渡して再計算させない
+	Hash128 source;
+	source.Update( text.c_str(), text.GetLen() );
+	const Hash128Value sourceHash = source.Get();
+	tjs_uint64 hash = sourceHash.Low;
+
+	tjs_uint64 settings = Script->GetSettingsHash();
+
+	std::shared_ptr<const ScenarioData> previous;
+	std::shared_ptr<const ScenarioData> data = Cache->Find( storage, hash, settings, &previous );
+	if( !data ) {
+		// applyEdit で編集中の内容が保存された時は、その解析結果を使う
+		data = FindEditedScenario( storage, hash, settings );
+		if( !data ) data = LoadCompiledScenario( storage, hash );
+		if( !data ) {
+			// 以前の解析結果がキャッシュにある時は、変更のない行を引き継ぐ
+			data = Script->Reparse( text.c_str(), previous, &sourceHash );
+			Cache->Add( storage, hash, settings, data );
+			return data;
+		}
+		Cache->Add( storage, hash, settings, data );
+	}
+	// 解析していないので、記録しておいた警告/エラーを出力する
+	if( ReplayDiagnostics ) data->LogDiagnostics();
+	return data;
+}
+//---------------------------------------------------------------------------
+std::shared_ptr<const ScenarioData> tTJSNI_MDKParser::FindEditedScenario( const ttstr& storage, tjs_uint64 sourceHash, tjs_uint64 settings ) {
+	auto found = Documents.find( tjs_string( storage.c_str() ) );
+	if( found == Documents.end() ) return nullptr;
+	EditDocument& doc = found->second;
+	if( !doc.Data || doc.SettingsHash != settings ) return nullptr;
+	if( !doc.HasSourceHash ) {
+		// 編集ごとには求めず、保存されたテキストと比べる時に行をつなげて求める
+		Hash128 source;
+		for( const ttstr& line : doc.Lines ) source.Update( line.c_str(), line.GetLen() );
+		doc.SourceHash = source.Get().Low;
+		doc.HasSourceHash = true;
+	}
+	return doc.SourceHash == sourceHash ? doc.Data : nullptr;
+}
+//---------------------------------------------------------------------------
+iTJSDispatch2 * tTJSNI_MDKParser::ParseMDKScenario( const ttstr& storage ) {
+	return ScenarioData::CreateScenario( LoadScenarioData( storage ), Script->GetOption() );
+}
+//---------------------------------------------------------------------------
+void tTJSNI_MDKParser::CompileMDKScenario( const ttstr& storage, const ttstr& out, bool image ) {
+	ttstr text;
+	ReadScenarioText( storage, text );
+	std::shared_ptr<const ScenarioData> data = Script->Parse( text.c_str() );
+	tjs_uint64 hash = Script->GetSourceHash().Low;
+
+	std::vector<tjs_uint8> buffer;
+	if( image ) {
+		ScenarioImage::Write( *data, hash, Script->GetSettingsHash(), buffer );
+	} else {
+		ScenarioBinary::Write( *data, hash, Script->GetSettingsHash(), buffer );
+	}
+
+	ttstr name = out.IsEmpty() ? ScenarioBinary::GetCompiledName( storage ) : out;
+	tTJSBinaryStream* stream = TVPCreateStream( name, TJS_BS_WRITE );
+	try {
+		stream->WriteBuffer( &buffer[0], static_cast<tjs_uint>( buffer.size() ) );
+	} catch( ... ) {
+		stream->Destruct();
+		throw;
+	}
+	stream->Destruct();
+}
+//---------------------------------------------------------------------------
+void tTJSNI_MDKParser::CompileMDKBundle( iTJSDispatch2* storages, const ttstr& out ) {
+	std::vector<tjs_uint8> buffer;
+	ScenarioBundle::Writer writer( buffer );
+	tTJSVariant count;
+	if( storages && TJS_SUCCEEDED( storages->PropGet( 0, TJS_W( "count" ), nullptr, &count, storages ) ) ) {
+		tjs_int num = count;
+		for( tjs_int i = 0; i < num; i++ ) {
+			tTJSVariant val;
+			storages->PropGetByNum( 0, i, &val, storages );
+			ttstr storage( val );
+			ttstr text;
+			ReadScenarioText( storage, text );
+			std::shared_ptr<const ScenarioData> data = Script->Parse( text.c_str() );
+			writer.Add( storage, Script->GetSourceHash().Low, *data );
+		}
+	}
+	writer.Finish( Script->GetSettingsHash() );
+
+	tTJSBinaryStream* stream = TVPCreateStream( out, TJS_BS_WRITE );
+	try {
+		stream->WriteBuffer( &buffer[0], static_cast<tjs_uint>( buffer.size() ) );
+	} catch( ... ) {
+		stream->Destruct();
+		throw;
+	}
+	stream->Destruct();
+}
+//---------------------------------------------------------------------------
+bool tTJSNI_MDKParser::OpenMDKBundle( const ttstr& storage ) {
+	Bundle = ScenarioBundle::Open( storage );
+	return Bundle != nullptr;
+}
+//---------------------------------------------------------------------------
+void tTJSNI_MDKParser::CloseMDKBundle() {
+	Bundle.reset();
+}
+//---------------------------------------------------------------------------
+iTJSDispatch2 * tTJSNI_MDKParser::ParseMDKBundledScenario( const ttstr& storage ) {
+	tjs_uint64 settings = Script->GetSettingsHash();
+	const ScenarioBundle::Entry* entry = nullptr;
+	if( Bundle && Bundle->GetSettingsHash() == settings ) entry = Bundle->Find( storage );
+	if( !entry ) return ParseMDKScenario( storage );
+
+	std::shared_ptr<const ScenarioData> data = Cache->Find( storage, entry->SourceHash, settings );
+	if( !data ) {
+		data = Bundle->Load( *entry );
+		if( !data ) return ParseMDKScenario( storage );
+		Cache->Add( storage, entry->SourceHash, settings, data );
+	}
+	if( ReplayDiagnostics ) data->LogDiagnostics();
+	return ScenarioData::CreateScenario( data, Script->GetOption() );
+}
+//---------------------------------------------------------------------------
+void tTJSNI_MDKParser::ExportMDKScenario( const ttstr& storage, const ttstr& out ) {
+	std::shared_ptr<const ScenarioData> data = LoadScenarioData( storage );
+
+	ttstr name = out.IsEmpty() ? ScenarioJson::GetJsonName( storage ) : out;
+	tTJSBinaryStream* stream = TVPCreateStream( name, TJS_BS_WRITE );
+	try {
+		ScenarioJson::Write( *data, Script->GetOption(), stream );
+	} catch( ... ) {
+		stream->Destruct();
+		throw;
+	}
+	stream->Destruct();
+}
+//---------------------------------------------------------------------------
+namespace {
+/** ハッシュを上位、下位の順に 32 桁の16進数にする */
+ttstr HashToString( const Hash128Value& hash ) {
+	static const tjs_char digits[] = TJS_W( "0123456789abcdef" );
+	tjs_char buf[33];
+	for( int i = 0; i < 16; i++ ) {
+		buf[i] = digits[( hash.High >> ( 60 - i * 4 ) ) & 0xf];
+		buf[16 + i] = digits[( hash.Low >> ( 60 - i * 4 ) ) & 0xf];
+	}
+	buf[32] = 0;
+	return ttstr( buf );
+}
+} // namespace
+//---------------------------------------------------------------------------
+ttstr tTJSNI_MDKParser::HashMDKSource( const ttstr& storage ) {
+	ttstr text;
+	ReadScenarioText( storage, text );
+	Hash128 hash;
+	hash.Update( text.c_str(), text.GetLen() );
+	return HashToString( hash.Get() );
+}
+//---------------------------------------------------------------------------
+ttstr tTJSNI_MDKParser::HashMDKScenario( const ttstr& storage ) {
+	return HashToString( LoadScenarioData( storage )->GetStructureHash() );
+}
+//---------------------------------------------------------------------------
+namespace {
+/** items の first から removed 個を values に置き換える。個数が同じ時は代入のみ */
+template<typename T>
+void ReplaceRange( std::vector<T>& items, tjs_int first, tjs_int removed, const std::vector<T>& values ) {
+	const tjs_int count = static_cast<tjs_int>( values.size() );
+	const tjs_int common = std::min( removed, count );
+	std::copy( values.begin(), values.begin() + common, items.begin() + first );
+	if( removed > common ) {
+		items.erase( items.begin() + first + common, items.begin() + first + removed );
+	} else {
+		items.insert( items.begin() + first + common, values.begin() + common, values.end() );
+	}
+}
+bool EndsWithNewLine( const ttstr& text ) {
+	tjs_int len = text.GetLen();
+	return len > 0 && ( text[len - 1] == TJS_W( '\r' ) || text[len - 1] == TJS_W( '\n' ) );
+}
+} // namespace
+//---------------------------------------------------------------------------
+iTJSDispatch2 * tTJSNI_MDKParser::ApplyEdit( const ttstr& storage, tjs_int firstLine, tjs_int lastLine, const ttstr& newText ) {
+	tjs_string key( storage.c_str() );
+	auto found = Documents.find( key );
+	if( found == Documents.end() ) {
+		ttstr text;
+		ReadScenarioText( storage, text );
+		EditDocument doc;
+		Parser::SplitLines( text.c_str(), text.GetLen(), doc.Lines, doc.Hashes );
+		found = Documents.insert( std::make_pair( key, std::move( doc ) ) ).first;
+	}
+	EditDocument& doc = found->second;
+
+	// 置き換える範囲、範囲外の指定は末尾への追加とする
+	const tjs_int count = static_cast<tjs_int>( doc.Lines.size() );
+	const tjs_int first = std::max( 0, std::min( firstLine, count ) );
+	const tjs_int last = std::max( first - 1, std::min( lastLine, count - 1 ) );
+	const tjs_int removed = last - first + 1;
+
+	std::vector<ttstr> lines;
+	std::vector<tjs_uint64> hashes;
+	Parser::SplitLines( newText.c_str(), newText.GetLen(), lines, hashes );
+	const tjs_int inserted = static_cast<tjs_int>( lines.size() );
+	// 後に行が続く時は置き換えた最後の行を改行で終え、改行のない最後の行の後に追加する時はその行を改行で終える
+	if( last + 1 < count && inserted > 0 && !EndsWithNewLine( lines.back() ) ) lines.back() += TJS_W( "\n" );
+	const bool terminate = first == count && first > 0 && inserted > 0 && !EndsWithNewLine( doc.Lines[first - 1] );
+
+	// 行を置き換えて解析する。解析に失敗した時は元に戻す
+	std::vector<ttstr> oldLines( doc.Lines.begin() + first, doc.Lines.begin() + first + removed );
+	std::vector<tjs_uint64> oldHashes( doc.Hashes.begin() + first, doc.Hashes.begin() + first + removed );
+	ReplaceRange( doc.Lines, first, removed, lines );
+	ReplaceRange( doc.Hashes, first, removed, hashes );
+	if( terminate ) doc.Lines[first - 1] += TJS_W( "\n" );
+
+	// 前回と同じ設定の時は変更のない行を引き継ぐ。引き継げるよう行ごとの状態は常に記録する
+	tjs_uint64 settings = Script->GetSettingsHash();
+	ScenarioOption& option = Script->GetOption();
+	bool incremental = option.Incremental;
+	option.Incremental = true;
+	std::shared_ptr<const ScenarioData> data;
+	try {
+		data = Script->ParseEdit( doc.Lines, doc.Hashes, doc.SettingsHash == settings ? doc.Data : nullptr, first, removed, inserted );
+	} catch( ... ) {
+		option.Incremental = incremental;
+		if( terminate ) doc.Lines[first - 1] = ttstr( doc.Lines[first - 1].c_str(), doc.Lines[first - 1].GetLen() - 1 );
+		ReplaceRange( doc.Lines, first, inserted, oldLines );
+		ReplaceRange( doc.Hashes, first, inserted, oldHashes );
+		throw;
+	}
+	option.Incremental = incremental;
+	doc.Data = data;
+	doc.SettingsHash = settings;
+	// 編集後の内容で保存された時は loadScenario が FindEditedScenario で引く
+	doc.HasSourceHash = false;
+
+	tjs_int begin, end;
+	Script->GetParsedRange( first, first + inserted - 1, begin, end );
+	// lines の位置に変換する。compactLines 指定時は元の行番号と異なる
+	tjs_int entryBegin = begin, entryEnd = end;
+	if( option.CompactLines ) {
+		std::vector<LineEntry> entries;
+		data->CreateEntries( option, entries );
+		ScenarioData::FindEntryRange( entries, begin, end, option, entryBegin, entryEnd );
+	}
+
+	iTJSDispatch2* result = TJSCreateDictionaryObject();
+	try {
+		iTJSDispatch2* scenario = ScenarioData::CreateScenario( data, option );
+		tTJSVariant val( scenario, scenario );
+		scenario->Release();
+		result->PropSetByVS( TJS_MEMBERENSURE, GetRWord()->scenario(), &val, result );
+		val = static_cast<tjs_int>( entryBegin );
+		result->PropSetByVS( TJS_MEMBERENSURE, GetRWord()->line(), &val, result );
+		val = static_cast<tjs_int>( entryEnd );
+		result->PropSetByVS( TJS_MEMBERENSURE, GetRWord()->end(), &val, result );
+		val = static_cast<tjs_int>( begin );
+		result->PropSetByVS( TJS_MEMBERENSURE, GetRWord()->sourceLine(), &val, result );
+		val = static_cast<tjs_int>( end );
+		result->PropSetByVS( TJS_MEMBERENSURE, GetRWord()->sourceEnd(), &val, result );
+	} catch( ... ) {
+		result->Release();
+		throw;
+	}
 	return result;
 }
-//---------------------------------------------------------------------------
\ No newline at end of file
+//---------------------------------------------------------------------------
+void tTJSNI_MDKParser::CloseEdit( const ttstr& storage ) {
+	Documents.erase( tjs_string( storage.c_str() ) );
+}
+//---------------------------------------------------------------------------
+iTJSDispatch2 * tTJSNI_MDKParser::ParseMDKScenarioFrom( const ttstr& storage, iTJSDispatch2* checkpoint, tjs_int endLine ) {
+	Parser::ParseCheckpoint start;
+	if( checkpoint ) {
+		tTJSVariant val;
+		if( TJS_SUCCEEDED( checkpoint->PropGet( 0, TJS_W( "line" ), nullptr, &val, checkpoint ) ) && val.Type() != tvtVoid ) {
+			start.Line = static_cast<tjs_int>( val.AsInteger() );
+		}
+		val.Clear();
+		if( TJS_SUCCEEDED( checkpoint->PropGet( 0, TJS_W( "selectLine" ), nullptr, &val, checkpoint ) ) ) {
+			start.HasSelectLine = val.operator bool();
+		}
+		val.Clear();
+		if( TJS_SUCCEEDED( checkpoint->PropGet( 0, TJS_W( "fixTagName" ), nullptr, &val, checkpoint ) ) && val.Type() == tvtString ) {
+			start.FixTagName = ttstr( val );
+		}
+	}
+	ttstr text;
+	ReadScenarioText( storage, text );
+	return ScenarioData::CreateScenario( Script->ParseFrom( text.c_str(), start, endLine ), Script->GetOption() );
+}
+//---------------------------------------------------------------------------
+bool tTJSNI_MDKParser::GetLazy() const {
+	return Script->GetOption().Lazy;
+}
+//---------------------------------------------------------------------------
+void tTJSNI_MDKParser::SetLazy( bool lazy ) {
+	Script->GetOption().Lazy = lazy;
+}
+//---------------------------------------------------------------------------
+bool tTJSNI_MDKParser::GetShareMarkerTags() const {
+	return Script->GetOption().SharedTags != nullptr;
+}
+//---------------------------------------------------------------------------
+void tTJSNI_MDKParser::SetShareMarkerTags( bool share ) {
+	ScenarioOption& option = Script->GetOption();
+	if( share ) {
+		if( !option.SharedTags ) option.SharedTags = std::make_shared<SharedTagCache>();
+	} else {
+		option.SharedTags.reset();
+	}
+}
+//---------------------------------------------------------------------------
+bool tTJSNI_MDKParser::GetKeepStringPool() const {
+	return Script->GetKeepStringPool();
+}
+//---------------------------------------------------------------------------
+void tTJSNI_MDKParser::SetKeepStringPool( bool keep ) {
+	Script->SetKeepStringPool( keep );
+}
+//---------------------------------------------------------------------------
+void tTJSNI_MDKParser::ClearStringPool() {
+	Script->ClearStringPool();
+}
+//---------------------------------------------------------------------------
+bool tTJSNI_MDKParser::GetSignBits() const {
+	return Script->GetOption().SignBits;
+}
+//---------------------------------------------------------------------------
+void tTJSNI_MDKParser::SetSignBits( bool sign ) {
+	Script->GetOption().SignBits = sign;
+}
+//---------------------------------------------------------------------------
+void tTJSNI_MDKParser::AddSignWord( const ttstr& sign, const ttstr& word ) {
+	if( sign.GetLen() > 0 ) {
+		Script->AddSignWord( sign[0], word );
+		Cache->Purge();
+	}
+}
+//---------------------------------------------------------------------------
+iTJSDispatch2* tTJSNI_MDKParser::GetSignWords() const {
+	iTJSDispatch2* ar = TJSCreateArrayObject();
+	const std::vector<ttstr>& words = Script->GetSignWords();
+	for( tjs_uint i = 0; i < words.size(); i++ ) {
+		tTJSVariant val( words[i] );
+		ar->PropSetByNum( TJS_MEMBERENSURE, i, &val, ar );
+	}
+	return ar;
+}
+//---------------------------------------------------------------------------
+void tTJSNI_MDKParser::RegisterTags( iTJSDispatch2* names ) {
+	std::vector<ttstr> tags;
+	if( names ) {
+		tTJSVariant count;
+		if( TJS_SUCCEEDED( names->PropGet( 0, TJS_W( "count" ), nullptr, &count, names ) ) ) {
+			tjs_int n = count;
+			tags.reserve( n );
+			for( tjs_int i = 0; i < n; i++ ) {
+				tTJSVariant name;
+				names->PropGetByNum( 0, i, &name, names );
+				tags.push_back( ttstr( name ) );
+			}
+		}
+	}
+	Script->RegisterTags( tags );
+	Cache->Purge();
+}
+//---------------------------------------------------------------------------
+bool tTJSNI_MDKParser::GetTimingFields() const {
+	return Script->GetOption().TimingFields;
+}
+//---------------------------------------------------------------------------
+void tTJSNI_MDKParser::SetTimingFields( bool timingFields ) {
+	Script->GetOption().TimingFields = timingFields;
+}
+//---------------------------------------------------------------------------
+bool tTJSNI_MDKParser::GetCompactLines() const {
+	return Script->GetOption().CompactLines;
+}
+//---------------------------------------------------------------------------
+void tTJSNI_MDKParser::SetCompactLines( bool compactLines ) {
+	Script->GetOption().CompactLines = compactLines;
+}
+//---------------------------------------------------------------------------
+bool tTJSNI_MDKParser::GetPlainText() const {
+	return Script->GetOption().PlainText;
+}
+//---------------------------------------------------------------------------
+void tTJSNI_MDKParser::SetPlainText( bool plainText ) {
+	if( Script->GetOption().PlainText != plainText ) Cache->Purge();
+	Script->GetOption().PlainText = plainText;
+}
+//---------------------------------------------------------------------------
+bool tTJSNI_MDKParser::GetIncremental() const {
+	return Script->GetOption().Incremental;
+}
+//---------------------------------------------------------------------------
+void tTJSNI_MDKParser::SetIncremental( bool incremental ) {
+	Script->GetOption().Incremental = incremental;
+}
+//---------------------------------------------------------------------------
+tjs_int tTJSNI_MDKParser::GetCheckpointInterval() const {
+	return Script->GetOption().CheckpointInterval;
+}
+//---------------------------------------------------------------------------
+void tTJSNI_MDKParser::SetCheckpointInterval( tjs_int interval ) {
+	if( interval < 0 ) interval = 0;
+	if( Script->GetOption().CheckpointInterval != interval ) Cache->Purge();
+	Script->GetOption().CheckpointInterval = interval;
+}
+//---------------------------------------------------------------------------
+bool tTJSNI_MDKParser::GetReplayDiagnostics() const {
+	return ReplayDiagnostics;
+}
+//---------------------------------------------------------------------------
+void tTJSNI_MDKParser::SetReplayDiagnostics( bool replay ) {
+	ReplayDiagnostics = replay;
+}
+//---------------------------------------------------------------------------
+tjs_int64 tTJSNI_MDKParser::GetCacheBudget() const {
+	return static_cast<tjs_int64>( Cache->GetBudget() );
+}
+//---------------------------------------------------------------------------
+void tTJSNI_MDKParser::SetCacheBudget( tjs_int64 budget ) {
+	Cache->SetBudget( budget > 0 ? static_cast<size_t>( budget ) : 0 );
+}
+//---------------------------------------------------------------------------
+tjs_int64 tTJSNI_MDKParser::GetCacheSize() const {
+	return static_cast<tjs_int64>( Cache->GetUsedSize() );
+}
+//---------------------------------------------------------------------------
+tjs_int tTJSNI_MDKParser::GetCacheCount() const {
+	return static_cast<tjs_int>( Cache->GetCount() );
+}
+//---------------------------------------------------------------------------
+tjs_int64 tTJSNI_MDKParser::GetCacheHits() const {
+	return static_cast<tjs_int64>( Cache->GetHits() );
+}
+//---------------------------------------------------------------------------
+tjs_int64 tTJSNI_MDKParser::GetCacheMisses() const {
+	return static_cast<tjs_int64>( Cache->GetMisses() );
+}
+//---------------------------------------------------------------------------
+void tTJSNI_MDKParser::Purge() {
+	Cache->Purge();
+}
+//---------------------------------------------------------------------------
@@ -8,6 +8,8 @@
 #endif
 #include "tp_stub.h"
 #include <memory>
+#include <unordered_map>
+#include <vector>
 
 
 //---------------------------------------------------------------------------
@@ -18,6 +20,24 @@ class tTJSNI_MDKParser : public tTJSNativeInstance
 	typedef tTJSNativeInstance inherited;
 
 	std::unique_ptr<class Parser> Script;
+	std::unique_ptr<class ScenarioCache> Cache;
+	std::shared_ptr<class ScenarioBundle> Bundle;
+
+	/**
+	 * applyEdit で編集中のシナリオ。解析結果の辞書は元のテキストを持たないので storage ごとに保持する
+	 * 編集した行だけを置き換えられるよう、テキストは行単位で持つ
+	 */
+	struct EditDocument {
+		std::vector<ttstr> Lines;		// 改行を含む各行
+		std::vector<tjs_uint64> Hashes;	// 各行の改行を除いた内容のハッシュ
+		tjs_uint64 SettingsHash = 0;	// Data を解析した時の設定
+		std::shared_ptr<const class ScenarioData> Data;
+		bool HasSourceHash = false;		// SourceHash を求めてあるか
+		tjs_uint64 SourceHash = 0;		// テキスト全体のハッシュ、loadScenario で必要になった時に求める
+	};
+	std::unordered_map<tjs_string, EditDocument> Documents;
+	// キャッシュやコンパイル済みファイルから読み込んだ時に、解析時の警告/エラーを再出力するか
+	bool ReplayDiagnostics = true;
 
 public:
 	tTJSNI_MDKParser();
@@ -25,11 +45,110 @@ public:
 	tjs_error TJS_INTF_METHOD Construct(tjs_int numparams, tTJSVariant **param, iTJSDispatch2 *tjs_obj);
 	void TJS_INTF_METHOD Invalidate();
 
+	/** シナリオを読み込む。一致するコンパイル済みファイルがある時はそちらを使う */
 	iTJSDispatch2 * ParseMDKScenario( const ttstr& storage );
+	/**
+	 * シナリオを解析し、コンパイル済みファイルに書き出す。out が空の時は storage + "c"
+	 * image が true の時はマップしてそのまま参照するイメージ形式で書き出す
+	 */
+	void CompileMDKScenario( const ttstr& storage, const ttstr& out, bool image );
+	/** storages のシナリオをすべて解析し、1つのバンドルにして out に書き出す */
+	void CompileMDKBundle( iTJSDispatch2* storages, const ttstr& out );
+	/** バンドルを開く。形式が異なるか壊れている時は false */
+	bool OpenMDKBundle( const ttstr& storage );
+	void CloseMDKBundle();
+	/**
+	 * 開いているバンドルからシナリオを読み込む。元のテキストは読まない
+	 * バンドルにないか解析設定が異なる時は loadScenario と同じく読み込む
+	 */
+	iTJSDispatch2 * ParseMDKBundledScenario( const ttstr& storage );
+	/**
+	 * シナリオを解析し、JSON で書き出す。out が空の時は storage + ".json"
+	 * loadScenario と同じくキャッシュとコンパイル済みファイルを使い、辞書は生成しない
+	 */
+	void ExportMDKScenario( const ttstr& storage, const ttstr& out );
+	/** 元のテキストの 128bit のハッシュを 32 桁の16進数で返す。解析はしない */
+	ttstr HashMDKSource( const ttstr& storage );
+	/**
+	 * 解析結果の構造の 128bit のハッシュを 32 桁の16進数で返す。loadScenario と同じく読み込む
+	 * コメントや書式だけの変更では値が変わらず、出力が変わったかどうかの判定に使える
+	 */
+	ttstr HashMDKScenario( const ttstr& storage );
+	/**
+	 * 編集中のシナリオの firstLine から lastLine の行を newText に置き換えて解析する。ファイルには書き込まない
+	 * 初めて編集する時は storage を読み込む。変更のない行は前回の解析結果から引き継ぎ、firstLine の付近から解析を再開する
+	 * firstLine/lastLine は元の行番号(0 始まり)。結果の辞書と、内容が変わった可能性のある範囲を返す
+	 * line/end は lines の位置(compactLines 指定時は void の行を除き空行をまとめた後の位置)、
+	 * sourceLine/sourceEnd は元の行番号。どちらも end を含み、該当する行がない時は end < line
+	 */
+	iTJSDispatch2 * ApplyEdit( const ttstr& storage, tjs_int firstLine, tjs_int lastLine, const ttstr& newText );
+	/** 編集中のシナリオを破棄する */
+	void CloseEdit( const ttstr& storage );
+	/**
+	 * checkpoints の要素の行から解析して結果の辞書を返す。endLine が負でない時はその行の手前まで
+	 * 解析した範囲外の行は void となる。キャッシュやコンパイル済みファイルは使わない
+	 */
+	iTJSDispatch2 * ParseMDKScenarioFrom( const ttstr& storage, iTJSDispatch2* checkpoint, tjs_int endLine );
+
+	/**
+	 * 行の辞書/配列を参照された時に生成するかどうか
+	 * 有効な時の lines は count と添字での参照/代入のみ対応し、Array ではないので add/find/assign 等は使えない
+	 */
+	bool GetLazy() const;
+	void SetLazy( bool lazy );
+	/** 属性を持たないタグを共有辞書で返すかどうか */
+	bool GetShareMarkerTags() const;
+	void SetShareMarkerTags( bool share );
+	/** 文字列プールを loadScenario をまたいで保持するかどうか */
+	bool GetKeepStringPool() const;
+	void SetKeepStringPool( bool keep );
+	void ClearStringPool();
+	/** 記号コマンド */
+	bool GetSignBits() const;
+	void SetSignBits( bool sign );
+	void AddSignWord( const ttstr& sign, const ttstr& word );
+	iTJSDispatch2* GetSignWords() const;
+	/** タグ名の配列を登録する */
+	void RegisterTags( iTJSDispatch2* names );
+	/** time/wait/fade をタグに直接格納するかどうか */
+	bool GetTimingFields() const;
+	void SetTimingFields( bool timingFields );
+	/** void の行を除き、連続する空行をまとめるかどうか */
+	bool GetCompactLines() const;
+	void SetCompactLines( bool compactLines );
+	/** 行ごとの表示テキストとルビを出力するかどうか */
+	bool GetPlainText() const;
+	void SetPlainText( bool plainText );
+	/** 行ごとの解析状態を記録し、キャッシュにある以前の解析結果から変更のない行を引き継ぐかどうか */
+	bool GetIncremental() const;
+	void SetIncremental( bool incremental );
+	/** チェックポイントを記録する間隔(行数)、0 の時は記録しない */
+	tjs_int GetCheckpointInterval() const;
+	void SetCheckpointInterval( tjs_int interval );
+	/** キャッシュやコンパイル済みファイルから読み込んだ時に、解析時の警告/エラーを再出力するかどうか */
+	bool GetReplayDiagnostics() const;
+	void SetReplayDiagnostics( bool replay );
+	/** 解析結果のキャッシュ、上限(バイト)が 0 の時はキャッシュしない */
+	tjs_int64 GetCacheBudget() const;
+	void SetCacheBudget( tjs_int64 budget );
+	tjs_int64 GetCacheSize() const;
+	tjs_int GetCacheCount() const;
+	tjs_int64 GetCacheHits() const;
+	tjs_int64 GetCacheMisses() const;
+	void Purge();
 
 private:
 	iTJSDispatch2 * Owner = nullptr; // owner object
 
+	/** シナリオのテキストを読み込む */
+	static void ReadScenarioText( const ttstr& storage, ttstr& text );
+	/** 解析結果を取得する。キャッシュかコンパイル済みファイルにない時は解析する */
+	std::shared_ptr<const class ScenarioData> LoadScenarioData( const ttstr& storage );
+	/** コンパイル済みファイルを読み込む。ないか一致しない時は nullptr */
+	std::shared_ptr<const class ScenarioData> LoadCompiledScenario( const ttstr& storage, tjs_uint64 sourceHash );
+	/** 編集中のシナリオが同じテキストと設定の時はその解析結果を返す。ない時は nullptr */
+	std::shared_ptr<const class ScenarioData> FindEditedScenario( const ttstr& storage, tjs_uint64 sourceHash, tjs_uint64 settings );
+
 };
 
 
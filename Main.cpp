@@ -53,6 +53,392 @@ iTJSDispatch2 * TVPCreateNativeClass_MDKParser() {
 	}
 	TJS_END_NATIVE_METHOD_DECL(/*func. name*/loadScenario )
 //----------------------------------------------------------------------
+	TJS_BEGIN_NATIVE_METHOD_DECL(/*func. name*/compileScenario ) {
+		TJS_GET_NATIVE_INSTANCE(/*var. name*/_this, /*var. type*/tTJSNI_MDKParser );
+		if( numparams < 1 ) return TJS_E_BADPARAMCOUNT;
+		ttstr out;
+		if( numparams >= 2 && param[1]->Type() != tvtVoid ) out = *param[1];
+		bool image = numparams >= 3 && param[2]->operator bool();
+		_this->CompileMDKScenario( *param[0], out, image );
+		return TJS_S_OK;
+	}
+	TJS_END_NATIVE_METHOD_DECL(/*func. name*/compileScenario )
+//----------------------------------------------------------------------
+	TJS_BEGIN_NATIVE_METHOD_DECL(/*func. name*/compileBundle ) {
+		TJS_GET_NATIVE_INSTANCE(/*var. name*/_this, /*var. type*/tTJSNI_MDKParser );
+		if( numparams < 2 ) return TJS_E_BADPARAMCOUNT;
+		_this->CompileMDKBundle( param[0]->Type() == tvtObject ? param[0]->AsObjectNoAddRef() : nullptr, *param[1] );
+		return TJS_S_OK;
+	}
+	TJS_END_NATIVE_METHOD_DECL(/*func. name*/compileBundle )
+//----------------------------------------------------------------------
+	TJS_BEGIN_NATIVE_METHOD_DECL(/*func. name*/openBundle ) {
+		TJS_GET_NATIVE_INSTANCE(/*var. name*/_this, /*var. type*/tTJSNI_MDKParser );
+		if( numparams < 1 ) return TJS_E_BADPARAMCOUNT;
+		bool opened = _this->OpenMDKBundle( *param[0] );
+		if( result ) *result = opened ? (tjs_int)1 : (tjs_int)0;
+		return TJS_S_OK;
+	}
+	TJS_END_NATIVE_METHOD_DECL(/*func. name*/openBundle )
+//----------------------------------------------------------------------
+	TJS_BEGIN_NATIVE_METHOD_DECL(/*func. name*/closeBundle ) {
+		TJS_GET_NATIVE_INSTANCE(/*var. name*/_this, /*var. type*/tTJSNI_MDKParser );
+		_this->CloseMDKBundle();
+		return TJS_S_OK;
+	}
+	TJS_END_NATIVE_METHOD_DECL(/*func. name*/closeBundle )
+//----------------------------------------------------------------------
+	TJS_BEGIN_NATIVE_METHOD_DECL(/*func. name*/loadBundledScenario ) {
+		TJS_GET_NATIVE_INSTANCE(/*var. name*/_this, /*var. type*/tTJSNI_MDKParser );
+		if( numparams < 1 ) return TJS_E_BADPARAMCOUNT;
+		if( result ) {
+			iTJSDispatch2* ret = _this->ParseMDKBundledScenario( *param[0] );
+			*result = tTJSVariant( ret, ret );
+			if( ret ) ret->Release();
+		}
+		return TJS_S_OK;
+	}
+	TJS_END_NATIVE_METHOD_DECL(/*func. name*/loadBundledScenario )
+//----------------------------------------------------------------------
+	TJS_BEGIN_NATIVE_METHOD_DECL(/*func. name*/exportJSON ) {
+		TJS_GET_NATIVE_INSTANCE(/*var. name*/_this, /*var. type*/tTJSNI_MDKParser );
+		if( numparams < 1 ) return TJS_E_BADPARAMCOUNT;
+		ttstr out;
+		if( numparams >= 2 && param[1]->Type() != tvtVoid ) out = *param[1];
+		_this->ExportMDKScenario( *param[0], out );
+		return TJS_S_OK;
+	}
+	TJS_END_NATIVE_METHOD_DECL(/*func. name*/exportJSON )
+//----------------------------------------------------------------------
+	TJS_BEGIN_NATIVE_METHOD_DECL(/*func. name*/hashSource ) {
+		TJS_GET_NATIVE_INSTANCE(/*var. name*/_this, /*var. type*/tTJSNI_MDKParser );
+		if( numparams < 1 ) return TJS_E_BADPARAMCOUNT;
+		ttstr ret = _this->HashMDKSource( *param[0] );
+		if( result ) *result = ret;
+		return TJS_S_OK;
+	}
+	TJS_END_NATIVE_METHOD_DECL(/*func. name*/hashSource )
+//----------------------------------------------------------------------
+	TJS_BEGIN_NATIVE_METHOD_DECL(/*func. name*/hashScenario ) {
+		TJS_GET_NATIVE_INSTANCE(/*var. name*/_this, /*var. type*/tTJSNI_MDKParser );
+		if( numparams < 1 ) return TJS_E_BADPARAMCOUNT;
+		ttstr ret = _this->HashMDKScenario( *param[0] );
+		if( result ) *result = ret;
+		return TJS_S_OK;
+	}
+	TJS_END_NATIVE_METHOD_DECL(/*func. name*/hashScenario )
+//----------------------------------------------------------------------
+	TJS_BEGIN_NATIVE_METHOD_DECL(/*func. name*/applyEdit ) {
+		TJS_GET_NATIVE_INSTANCE(/*var. name*/_this, /*var. type*/tTJSNI_MDKParser );
+		if( numparams < 4 ) return TJS_E_BADPARAMCOUNT;
+		iTJSDispatch2* ret = _this->ApplyEdit( *param[0], *param[1], *param[2], *param[3] );
+		if( result ) *result = tTJSVariant( ret, ret );
+		ret->Release();
+		return TJS_S_OK;
+	}
+	TJS_END_NATIVE_METHOD_DECL(/*func. name*/applyEdit )
+//----------------------------------------------------------------------
+	TJS_BEGIN_NATIVE_METHOD_DECL(/*func. name*/closeEdit ) {
+		TJS_GET_NATIVE_INSTANCE(/*var. name*/_this, /*var. type*/tTJSNI_MDKParser );
+		if( numparams < 1 ) return TJS_E_BADPARAMCOUNT;
+		_this->CloseEdit( *param[0] );
+		return TJS_S_OK;
+	}
+	TJS_END_NATIVE_METHOD_DECL(/*func. name*/closeEdit )
+//----------------------------------------------------------------------
+	TJS_BEGIN_NATIVE_METHOD_DECL(/*func. name*/loadScenarioFrom ) {
+		TJS_GET_NATIVE_INSTANCE(/*var. name*/_this, /*var. type*/tTJSNI_MDKParser );
+		if( numparams < 2 ) return TJS_E_BADPARAMCOUNT;
+		tjs_int endLine = -1;
+		if( numparams >= 3 && param[2]->Type() != tvtVoid ) endLine = *param[2];
+		iTJSDispatch2* ret = _this->ParseMDKScenarioFrom( *param[0], param[1]->Type() == tvtObject ? param[1]->AsObjectNoAddRef() : nullptr, endLine );
+		if( result ) *result = tTJSVariant( ret, ret );
+		if( ret ) ret->Release();
+		return TJS_S_OK;
+	}
+	TJS_END_NATIVE_METHOD_DECL(/*func. name*/loadScenarioFrom )
+//----------------------------------------------------------------------
+	TJS_BEGIN_NATIVE_PROP_DECL( lazy ) {
+		TJS_BEGIN_NATIVE_PROP_GETTER {
+			TJS_GET_NATIVE_INSTANCE(/*var. name*/_this, /*var. type*/tTJSNI_MDKParser );
+			if( result ) *result = _this->GetLazy() ? (tjs_int)1 : (tjs_int)0;
+			return TJS_S_OK;
+		}
+		TJS_END_NATIVE_PROP_GETTER
+
+		TJS_BEGIN_NATIVE_PROP_SETTER {
+			TJS_GET_NATIVE_INSTANCE(/*var. name*/_this, /*var. type*/tTJSNI_MDKParser );
+			_this->SetLazy( param->operator bool() );
+			return TJS_S_OK;
+		}
+		TJS_END_NATIVE_PROP_SETTER
+	}
+	TJS_END_NATIVE_PROP_DECL( lazy )
+//----------------------------------------------------------------------
+	TJS_BEGIN_NATIVE_PROP_DECL( shareMarkerTags ) {
+		TJS_BEGIN_NATIVE_PROP_GETTER {
+			TJS_GET_NATIVE_INSTANCE(/*var. name*/_this, /*var. type*/tTJSNI_MDKParser );
+			if( result ) *result = _this->GetShareMarkerTags() ? (tjs_int)1 : (tjs_int)0;
+			return TJS_S_OK;
+		}
+		TJS_END_NATIVE_PROP_GETTER
+
+		TJS_BEGIN_NATIVE_PROP_SETTER {
+			TJS_GET_NATIVE_INSTANCE(/*var. name*/_this, /*var. type*/tTJSNI_MDKParser );
+			_this->SetShareMarkerTags( param->operator bool() );
+			return TJS_S_OK;
+		}
+		TJS_END_NATIVE_PROP_SETTER
+	}
+	TJS_END_NATIVE_PROP_DECL( shareMarkerTags )
+//----------------------------------------------------------------------
+	TJS_BEGIN_NATIVE_PROP_DECL( keepStringPool ) {
+		TJS_BEGIN_NATIVE_PROP_GETTER {
+			TJS_GET_NATIVE_INSTANCE(/*var. name*/_this, /*var. type*/tTJSNI_MDKParser );
+			if( result ) *result = _this->GetKeepStringPool() ? (tjs_int)1 : (tjs_int)0;
+			return TJS_S_OK;
+		}
+		TJS_END_NATIVE_PROP_GETTER
+
+		TJS_BEGIN_NATIVE_PROP_SETTER {
+			TJS_GET_NATIVE_INSTANCE(/*var. name*/_this, /*var. type*/tTJSNI_MDKParser );
+			_this->SetKeepStringPool( param->operator bool() );
+			return TJS_S_OK;
+		}
+		TJS_END_NATIVE_PROP_SETTER
+	}
+	TJS_END_NATIVE_PROP_DECL( keepStringPool )
+//----------------------------------------------------------------------
+	TJS_BEGIN_NATIVE_METHOD_DECL(/*func. name*/clearStringPool ) {
+		TJS_GET_NATIVE_INSTANCE(/*var. name*/_this, /*var. type*/tTJSNI_MDKParser );
+		_this->ClearStringPool();
+		return TJS_S_OK;
+	}
+	TJS_END_NATIVE_METHOD_DECL(/*func. name*/clearStringPool )
+//----------------------------------------------------------------------
+	TJS_BEGIN_NATIVE_PROP_DECL( signBits ) {
+		TJS_BEGIN_NATIVE_PROP_GETTER {
+			TJS_GET_NATIVE_INSTANCE(/*var. name*/_this, /*var. type*/tTJSNI_MDKParser );
+			if( result ) *result = _this->GetSignBits() ? (tjs_int)1 : (tjs_int)0;
+			return TJS_S_OK;
+		}
+		TJS_END_NATIVE_PROP_GETTER
+
+		TJS_BEGIN_NATIVE_PROP_SETTER {
+			TJS_GET_NATIVE_INSTANCE(/*var. name*/_this, /*var. type*/tTJSNI_MDKParser );
+			_this->SetSignBits( param->operator bool() );
+			return TJS_S_OK;
+		}
+		TJS_END_NATIVE_PROP_SETTER
+	}
+	TJS_END_NATIVE_PROP_DECL( signBits )
+//----------------------------------------------------------------------
+	TJS_BEGIN_NATIVE_PROP_DECL( signWords ) {
+		TJS_BEGIN_NATIVE_PROP_GETTER {
+			TJS_GET_NATIVE_INSTANCE(/*var. name*/_this, /*var. type*/tTJSNI_MDKParser );
+			if( result ) {
+				iTJSDispatch2* ret = _this->GetSignWords();
+				*result = tTJSVariant( ret, ret );
+				ret->Release();
+			}
+			return TJS_S_OK;
+		}
+		TJS_END_NATIVE_PROP_GETTER
+
+		TJS_DENY_NATIVE_PROP_SETTER
+	}
+	TJS_END_NATIVE_PROP_DECL( signWords )
+//----------------------------------------------------------------------
+	TJS_BEGIN_NATIVE_METHOD_DECL(/*func. name*/addSignWord ) {
+		TJS_GET_NATIVE_INSTANCE(/*var. name*/_this, /*var. type*/tTJSNI_MDKParser );
+		if( numparams < 2 ) return TJS_E_BADPARAMCOUNT;
+		_this->AddSignWord( *param[0], *param[1] );
+		return TJS_S_OK;
+	}
+	TJS_END_NATIVE_METHOD_DECL(/*func. name*/addSignWord )
+//----------------------------------------------------------------------
+	TJS_BEGIN_NATIVE_METHOD_DECL(/*func. name*/registerTags ) {
+		TJS_GET_NATIVE_INSTANCE(/*var. name*/_this, /*var. type*/tTJSNI_MDKParser );
+		if( numparams < 1 ) return TJS_E_BADPARAMCOUNT;
+		_this->RegisterTags( param[0]->Type() == tvtObject ? param[0]->AsObjectNoAddRef() : nullptr );
+		return TJS_S_OK;
+	}
+	TJS_END_NATIVE_METHOD_DECL(/*func. name*/registerTags )
+//----------------------------------------------------------------------
+	TJS_BEGIN_NATIVE_PROP_DECL( timingFields ) {
+		TJS_BEGIN_NATIVE_PROP_GETTER {
+			TJS_GET_NATIVE_INSTANCE(/*var. name*/_this, /*var. type*/tTJSNI_MDKParser );
+			if( result ) *result = _this->GetTimingFields() ? (tjs_int)1 : (tjs_int)0;
+			return TJS_S_OK;
+		}
+		TJS_END_NATIVE_PROP_GETTER
+
+		TJS_BEGIN_NATIVE_PROP_SETTER {
+			TJS_GET_NATIVE_INSTANCE(/*var. name*/_this, /*var. type*/tTJSNI_MDKParser );
+			_this->SetTimingFields( param->operator bool() );
+			return TJS_S_OK;
+		}
+		TJS_END_NATIVE_PROP_SETTER
+	}
+	TJS_END_NATIVE_PROP_DECL( timingFields )
+//----------------------------------------------------------------------
+	TJS_BEGIN_NATIVE_PROP_DECL( compactLines ) {
+		TJS_BEGIN_NATIVE_PROP_GETTER {
+			TJS_GET_NATIVE_INSTANCE(/*var. name*/_this, /*var. type*/tTJSNI_MDKParser );
+			if( result ) *result = _this->GetCompactLines() ? (tjs_int)1 : (tjs_int)0;
+			return TJS_S_OK;
+		}
+		TJS_END_NATIVE_PROP_GETTER
+
+		TJS_BEGIN_NATIVE_PROP_SETTER {
+			TJS_GET_NATIVE_INSTANCE(/*var. name*/_this, /*var. type*/tTJSNI_MDKParser );
+			_this->SetCompactLines( param->operator bool() );
+			return TJS_S_OK;
+		}
+		TJS_END_NATIVE_PROP_SETTER
+	}
+	TJS_END_NATIVE_PROP_DECL( compactLines )
+//----------------------------------------------------------------------
+	TJS_BEGIN_NATIVE_PROP_DECL( plainText ) {
+		TJS_BEGIN_NATIVE_PROP_GETTER {
+			TJS_GET_NATIVE_INSTANCE(/*var. name*/_this, /*var. type*/tTJSNI_MDKParser );
+			if( result ) *result = _this->GetPlainText() ? (tjs_int)1 : (tjs_int)0;
+			return TJS_S_OK;
+		}
+		TJS_END_NATIVE_PROP_GETTER
+
+		TJS_BEGIN_NATIVE_PROP_SETTER {
+			TJS_GET_NATIVE_INSTANCE(/*var. name*/_this, /*var. type*/tTJSNI_MDKParser );
+			_this->SetPlainText( param->operator bool() );
+			return TJS_S_OK;
+		}
+		TJS_END_NATIVE_PROP_SETTER
+	}
+	TJS_END_NATIVE_PROP_DECL( plainText )
+//----------------------------------------------------------------------
+	TJS_BEGIN_NATIVE_PROP_DECL( incremental ) {
+		TJS_BEGIN_NATIVE_PROP_GETTER {
+			TJS_GET_NATIVE_INSTANCE(/*var. name*/_this, /*var. type*/tTJSNI_MDKParser );
+			if( result ) *result = _this->GetIncremental() ? (tjs_int)1 : (tjs_int)0;
+			return TJS_S_OK;
+		}
+		TJS_END_NATIVE_PROP_GETTER
+
+		TJS_BEGIN_NATIVE_PROP_SETTER {
+			TJS_GET_NATIVE_INSTANCE(/*var. name*/_this, /*var. type*/tTJSNI_MDKParser );
+			_this->SetIncremental( param->operator bool() );
+			return TJS_S_OK;
+		}
+		TJS_END_NATIVE_PROP_SETTER
+	}
+	TJS_END_NATIVE_PROP_DECL( incremental )
+//----------------------------------------------------------------------
+	TJS_BEGIN_NATIVE_PROP_DECL( checkpointInterval ) {
+		TJS_BEGIN_NATIVE_PROP_GETTER {
+			TJS_GET_NATIVE_INSTANCE(/*var. name*/_this, /*var. type*/tTJSNI_MDKParser );
+			if( result ) *result = _this->GetCheckpointInterval();
+			return TJS_S_OK;
+		}
+		TJS_END_NATIVE_PROP_GETTER
+
+		TJS_BEGIN_NATIVE_PROP_SETTER {
+			TJS_GET_NATIVE_INSTANCE(/*var. name*/_this, /*var. type*/tTJSNI_MDKParser );
+			_this->SetCheckpointInterval( static_cast<tjs_int>( param->AsInteger() ) );
+			return TJS_S_OK;
+		}
+		TJS_END_NATIVE_PROP_SETTER
+	}
+	TJS_END_NATIVE_PROP_DECL( checkpointInterval )
+//----------------------------------------------------------------------
+	TJS_BEGIN_NATIVE_PROP_DECL( replayDiagnostics ) {
+		TJS_BEGIN_NATIVE_PROP_GETTER {
+			TJS_GET_NATIVE_INSTANCE(/*var. name*/_this, /*var. type*/tTJSNI_MDKParser );
+			if( result ) *result = _this->GetReplayDiagnostics() ? (tjs_int)1 : (tjs_int)0;
+			return TJS_S_OK;
+		}
+		TJS_END_NATIVE_PROP_GETTER
+
+		TJS_BEGIN_NATIVE_PROP_SETTER {
+			TJS_GET_NATIVE_INSTANCE(/*var. name*/_this, /*var. type*/tTJSNI_MDKParser );
+			_this->SetReplayDiagnostics( param->operator bool() );
+			return TJS_S_OK;
+		}
+		TJS_END_NATIVE_PROP_SETTER
+	}
+	TJS_END_NATIVE_PROP_DECL( replayDiagnostics )
+//----------------------------------------------------------------------
+	TJS_BEGIN_NATIVE_PROP_DECL( cacheBudget ) {
+		TJS_BEGIN_NATIVE_PROP_GETTER {
+			TJS_GET_NATIVE_INSTANCE(/*var. name*/_this, /*var. type*/tTJSNI_MDKParser );
+			if( result ) *result = _this->GetCacheBudget();
+			return TJS_S_OK;
+		}
+		TJS_END_NATIVE_PROP_GETTER
+
+		TJS_BEGIN_NATIVE_PROP_SETTER {
+			TJS_GET_NATIVE_INSTANCE(/*var. name*/_this, /*var. type*/tTJSNI_MDKParser );
+			_this->SetCacheBudget( param->AsInteger() );
+			return TJS_S_OK;
+		}
+		TJS_END_NATIVE_PROP_SETTER
+	}
+	TJS_END_NATIVE_PROP_DECL( cacheBudget )
+//----------------------------------------------------------------------
+	TJS_BEGIN_NATIVE_PROP_DECL( cacheSize ) {
+		TJS_BEGIN_NATIVE_PROP_GETTER {
+			TJS_GET_NATIVE_INSTANCE(/*var. name*/_this, /*var. type*/tTJSNI_MDKParser );
+			if( result ) *result = _this->GetCacheSize();
+			return TJS_S_OK;
+		}
+		TJS_END_NATIVE_PROP_GETTER
+
+		TJS_DENY_NATIVE_PROP_SETTER
+	}
+	TJS_END_NATIVE_PROP_DECL( cacheSize )
+//----------------------------------------------------------------------
+	TJS_BEGIN_NATIVE_PROP_DECL( cacheCount ) {
+		TJS_BEGIN_NATIVE_PROP_GETTER {
+			TJS_GET_NATIVE_INSTANCE(/*var. name*/_this, /*var. type*/tTJSNI_MDKParser );
+			if( result ) *result = _this->GetCacheCount();
+			return TJS_S_OK;
+		}
+		TJS_END_NATIVE_PROP_GETTER
+
+		TJS_DENY_NATIVE_PROP_SETTER
+	}
+	TJS_END_NATIVE_PROP_DECL( cacheCount )
+//----------------------------------------------------------------------
+	TJS_BEGIN_NATIVE_PROP_DECL( cacheHits ) {
+		TJS_BEGIN_NATIVE_PROP_GETTER {
+			TJS_GET_NATIVE_INSTANCE(/*var. name*/_this, /*var. type*/tTJSNI_MDKParser );
+			if( result ) *result = _this->GetCacheHits();
+			return TJS_S_OK;
+		}
+		TJS_END_NATIVE_PROP_GETTER
+
+		TJS_DENY_NATIVE_PROP_SETTER
+	}
+	TJS_END_NATIVE_PROP_DECL( cacheHits )
+//----------------------------------------------------------------------
+	TJS_BEGIN_NATIVE_PROP_DECL( cacheMisses ) {
+		TJS_BEGIN_NATIVE_PROP_GETTER {
+			TJS_GET_NATIVE_INSTANCE(/*var. name*/_this, /*var. type*/tTJSNI_MDKParser );
+			if( result ) *result = _this->GetCacheMisses();
+			return TJS_S_OK;
+		}
+		TJS_END_NATIVE_PROP_GETTER
+
+		TJS_DENY_NATIVE_PROP_SETTER
+	}
+	TJS_END_NATIVE_PROP_DECL( cacheMisses )
+//----------------------------------------------------------------------
+	TJS_BEGIN_NATIVE_METHOD_DECL(/*func. name*/purge ) {
+		TJS_GET_NATIVE_INSTANCE(/*var. name*/_this, /*var. type*/tTJSNI_MDKParser );
+		_this->Purge();
+		return TJS_S_OK;
+	}
+	TJS_END_NATIVE_METHOD_DECL(/*func. name*/purge )
+//----------------------------------------------------------------------
 
 //----------------------------------------------------------------------
 	TJS_END_NATIVE_MEMBERS
@@ -0,0 +1,67 @@
+
+#include "MappedFile.h"
+
+//---------------------------------------------------------------------------
+MappedFile::~MappedFile() {
+#ifdef _WIN32
+	if( Data && Buffer.empty() ) ::UnmapViewOfFile( Data );
+	if( Mapping ) ::CloseHandle( Mapping );
+	if( File != INVALID_HANDLE_VALUE ) ::CloseHandle( File );
+#endif
+}
+//---------------------------------------------------------------------------
+bool MappedFile::Map( const ttstr& local ) {
+#ifdef _WIN32
+	File = ::CreateFileW( reinterpret_cast<LPCWSTR>( local.c_str() ), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr );
+	if( File == INVALID_HANDLE_VALUE ) return false;
+	LARGE_INTEGER size;
+	if( !::GetFileSizeEx( File, &size ) || size.QuadPart == 0 || static_cast<tjs_uint64>( size.QuadPart ) > static_cast<tjs_uint64>( static_cast<size_t>( -1 ) ) ) {
+		return false;
+	}
+	Mapping = ::CreateFileMappingW( File, nullptr, PAGE_READONLY, 0, 0, nullptr );
+	if( !Mapping ) return false;
+	void* view = ::MapViewOfFile( Mapping, FILE_MAP_READ, 0, 0, 0 );
+	if( !view ) return false;
+	Data = static_cast<const tjs_uint8*>( view );
+	Size = static_cast<size_t>( size.QuadPart );
+	return true;
+#else
+	return false;
+#endif
+}
+//---------------------------------------------------------------------------
+void MappedFile::Load( const ttstr& storage ) {
+	tTJSBinaryStream* stream = TVPCreateStream( storage, TJS_BS_READ );
+	try {
+		tjs_uint64 size = stream->GetSize();
+		Buffer.resize( static_cast<size_t>( size ) );
+		if( size ) stream->ReadBuffer( &Buffer[0], static_cast<tjs_uint>( size ) );
+	} catch( ... ) {
+		stream->Destruct();
+		throw;
+	}
+	stream->Destruct();
+	Data = Buffer.empty() ? nullptr : &Buffer[0];
+	Size = Buffer.size();
+}
+//---------------------------------------------------------------------------
+std::shared_ptr<MappedFile> MappedFile::Open( const ttstr& storage ) {
+	if( !TVPIsExistentStorage( storage ) ) return nullptr;
+	std::shared_ptr<MappedFile> file( new MappedFile() );
+
+	// ローカルのファイルの時はマップする
+	ttstr local = TVPGetPlacedPath( storage );
+	if( !local.IsEmpty() ) {
+		try {
+			TVPGetLocalName( local );
+		} catch( ... ) {
+			local.Clear();
+		}
+	}
+	if( !local.IsEmpty() && file->Map( local ) ) return file;
+
+	file.reset( new MappedFile() );
+	file->Load( storage );
+	return file;
+}
+//---------------------------------------------------------------------------
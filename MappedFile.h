@@ -0,0 +1,46 @@
+/**
+ * ファイルを読み込み専用でメモリにマップする
+ * ローカルのファイルでない時(アーカイブ内等)やマップできない環境では、メモリに読み込む
+ */
+#ifndef __MAPPED_FILE_H__
+#define __MAPPED_FILE_H__
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+#include "tp_stub.h"
+#include <vector>
+#include <memory>
+
+class MappedFile {
+	const tjs_uint8* Data = nullptr;
+	size_t Size = 0;
+	// マップできなかった時に読み込んだ内容
+	std::vector<tjs_uint8> Buffer;
+#ifdef _WIN32
+	HANDLE File = INVALID_HANDLE_VALUE;
+	HANDLE Mapping = nullptr;
+#endif
+
+	MappedFile() {}
+	MappedFile( const MappedFile& ) = delete;
+	MappedFile& operator=( const MappedFile& ) = delete;
+
+	/** ローカルのファイルをマップする */
+	bool Map( const ttstr& local );
+	/** ストレージから読み込む */
+	void Load( const ttstr& storage );
+
+public:
+	~MappedFile();
+
+	/** ストレージを開く。存在しない時は nullptr を返す */
+	static std::shared_ptr<MappedFile> Open( const ttstr& storage );
+
+	const tjs_uint8* GetData() const { return Data; }
+	size_t GetSize() const { return Size; }
+	/** マップしているか(false の時は読み込んだ内容) */
+	bool IsMapped() const { return Data != nullptr && Buffer.empty(); }
+};
+
+#endif // __MAPPED_FILE_H__
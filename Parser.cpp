@@ -11,12 +11,21 @@
 #include "Parser.h"
 #include "Tag.h"
 #include "ScenarioDictionary.h"
+#include "ScenarioBinary.h"
+#include "Hash.h"
 #include <assert.h>
+#include <algorithm>
 #include "MDKMessages.h"
 
 #define TVPThrowInternalError \
 	TVPThrowExceptionMessage(TVPMdkGetText(NUM_MDK_INTERNAL_ERROR), __FILE__,  __LINE__)
 
+// パーサーが記録する解析状態のビット
+static const tjs_uint32 ParserStateFlags = static_cast<tjs_uint32>( LineStateFlag::MultiLineTag ) | static_cast<tjs_uint32>( LineStateFlag::HasSelectLine );
+// この状態の行の前後では、まとめて写す範囲を区切らない
+static const tjs_uint32 OpenStateFlags = static_cast<tjs_uint32>( LineStateFlag::MultiLineTag ) | static_cast<tjs_uint32>( LineStateFlag::HasSelectLine )
+	| static_cast<tjs_uint32>( LineStateFlag::OpenPage ) | static_cast<tjs_uint32>( LineStateFlag::OpenSelect );
+
 template <typename TContainer>
 void split( const tjs_string& val, const tjs_char& delim, TContainer& result ) {
 	result.clear();
@@ -81,12 +90,12 @@ static void TJS_eTJSCompileError( const tjs_char *msg ) {
 // tTJSScriptBlock
 //---------------------------------------------------------------------------
 void Parser::Initialize() {
-	TagCommandPair.insert(std::make_pair(Token::PLUS, ttstr(TJS_W("add"))));
-	TagCommandPair.insert(std::make_pair(Token::MINUS, ttstr(TJS_W("del"))));
-	TagCommandPair.insert(std::make_pair(Token::ASTERISK, ttstr(TJS_W("all"))));
-	//TagCommandPair.insert(std::make_pair(Token::SHARP, ttstr(TJS_W("sync"))));
-	TagCommandPair.insert(std::make_pair(Token::EXCRAMATION, ttstr(TJS_W("sync"))));
-	TagCommandPair.insert(std::make_pair(Token::AMPERSAND, ttstr(TJS_W("nowait"))));
+	RegisterSignWord( Token::PLUS, ttstr(TJS_W("add")) );
+	RegisterSignWord( Token::MINUS, ttstr(TJS_W("del")) );
+	RegisterSignWord( Token::ASTERISK, ttstr(TJS_W("all")) );
+	//RegisterSignWord( Token::SHARP, ttstr(TJS_W("sync")) );
+	RegisterSignWord( Token::EXCRAMATION, ttstr(TJS_W("sync")) );
+	RegisterSignWord( Token::AMPERSAND, ttstr(TJS_W("nowait")) );
 
 	//SignToToken.insert(std::make_pair(TJS_W('>'),Token::GT));
 	//SignToToken.insert(std::make_pair(TJS_W('<'),Token::LT));
@@ -116,13 +125,43 @@ void Parser::Initialize() {
 	//SignToToken.insert(std::make_pair(TJS_W('$'),Token::DOLLAR));
 	SignToToken.insert(std::make_pair(TJS_W('@'),Token::AT));
 	SignToToken.insert(std::make_pair(TJS_W('|'),Token::VERTLINE));
+
+	AddReservedWords();
+}
+//---------------------------------------------------------------------------
+void Parser::AddReservedWords() {
+	// 予約語はプールに常駐させ、シンボルと同じ文字列となるようにする
+	std::vector<ttstr> words;
+	GetRWord()->GetWords( words );
+	for( const auto& word : words ) {
+		Strings.AddPermanent( word );
+	}
+}
+//---------------------------------------------------------------------------
+/**
+ * 記号にコマンドを割り当てる
+ * コマンド名ごとに sign のビットを割り当てる、同じ名前には同じビットを使う
+ */
+bool Parser::RegisterSignWord( Token token, const ttstr& word ) {
+	tjs_uint32 bit = 0;
+	size_t pos = 0;
+	for( ; pos < SignWords.size(); pos++ ) {
+		if( SignWords[pos] == word ) break;
+	}
+	if( pos < 32 ) bit = 1U << pos;
+
+	SignCommand command = { word, bit };
+	auto result = TagCommandPair.insert( std::make_pair( token, command ) );
+	if( result.second && pos == SignWords.size() && pos < 32 ) {
+		SignWords.push_back( word );
+	}
+	return result.second;
 }
 //---------------------------------------------------------------------------
 void Parser::AddSignWord( tjs_char sign, const ttstr& word ) {
 	auto tokenpair = SignToToken.find( sign );
 	if( tokenpair != SignToToken.end() ) {
-		auto result = TagCommandPair.insert(std::make_pair(tokenpair->second , word));
-		if( !result.second ) {
+		if( !RegisterSignWord( tokenpair->second, word ) ) {
 			tjs_char ptr[128];
 			TJS_snprintf(ptr, sizeof(ptr)/sizeof(tjs_char), TVPMdkGetText( NUM_MDK_ALREADY_REGISTERED ).c_str(), sign);
 			TVPAddLog( ptr );
@@ -134,7 +173,47 @@ void Parser::AddSignWord( tjs_char sign, const ttstr& word ) {
 	}
 }
 //---------------------------------------------------------------------------
-ttstr* Parser::GetTagSignWord( Token token ) {
+void Parser::RegisterTags( const std::vector<ttstr>& names ) {
+	TagIds.clear();
+	// 登録を解除したタグ名が常駐し続けないよう、予約語と今回のタグ名で作り直す
+	Strings.ClearPermanent();
+	AddReservedWords();
+	for( tjs_uint i = 0; i < names.size(); i++ ) {
+		// タグ名はプールに常駐させ、ポインタで引けるようにする
+		const ttstr& name = Strings.AddPermanent( names[i] );
+		TagIds.insert( std::make_pair( name.AsVariantStringNoAddRef(), static_cast<tjs_int32>( i ) ) );
+	}
+}
+//---------------------------------------------------------------------------
+tjs_uint64 Parser::GetSettingsHash() const {
+	Hash64 h;
+	// 登録されたタグ名を番号順に
+	std::vector<const tTJSVariantString*> tags( TagIds.size() );
+	for( const auto& tag : TagIds ) {
+		tags[tag.second] = tag.first;
+	}
+	h.Update( static_cast<tjs_uint64>( tags.size() ) );
+	for( const auto* tag : tags ) {
+		h.Update( ttstr( tag ) );
+	}
+	// 記号とコマンド、割り当てたビット
+	h.Update( static_cast<tjs_uint64>( TagCommandPair.size() ) );
+	for( const auto& pair : TagCommandPair ) {
+		h.Update( static_cast<tjs_uint64>( pair.first ) );
+		h.Update( pair.second.Word );
+		h.Update( static_cast<tjs_uint64>( pair.second.Bit ) );
+	}
+	h.Update( static_cast<tjs_uint64>( Option.PlainText ? 1 : 0 ) );
+	h.Update( static_cast<tjs_uint64>( Option.CheckpointInterval > 0 ? Option.CheckpointInterval : 0 ) );
+	return h.Get();
+}
+//---------------------------------------------------------------------------
+std::shared_ptr<const ScenarioData> Parser::LoadCompiled( const tjs_uint8* buffer, size_t size, tjs_uint64 sourceHash ) {
+	if( !KeepStringPool ) Strings.Clear();
+	return ScenarioBinary::Read( buffer, size, sourceHash, GetSettingsHash(), Strings );
+}
+//---------------------------------------------------------------------------
+const Parser::SignCommand* Parser::GetTagSignWord( Token token ) {
 	auto ret = TagCommandPair.find( token );
 	if( ret != TagCommandPair.end() ) {
 		return &ret->second;
@@ -144,19 +223,45 @@ ttstr* Parser::GetTagSignWord( Token token ) {
 //---------------------------------------------------------------------------
 Parser::Parser() {
 	Lex.reset( new LexicalAnalyzer(this) );
+	CurrentTag.reset( new Tag() );
+	DecorationTag.reset( new Tag() );
+	WorkTag.reset( new Tag() );
 }
 //---------------------------------------------------------------------------
 Parser::~Parser() {
+	CurrentTag.reset();
+	DecorationTag.reset();
+	WorkTag.reset();
+	Scenario.reset();
 	Lex.reset();
 }
 //---------------------------------------------------------------------------
 const tjs_char * Parser::GetLine(tjs_int line, tjs_int *linelength) const
 {
 	// note that this function DOES matter LineOffset
+	if( EditLines ) {
+		// 行単位のテキストの時は末尾の改行を除く
+		const ttstr& text = (*EditLines)[line];
+		tjs_int length = text.GetLen();
+		if( length > 0 && text[length - 1] == TJS_W( '\n' ) ) length--;
+		if( length > 0 && text[length - 1] == TJS_W( '\r' ) ) length--;
+		if(linelength) *linelength = length;
+		return text.c_str();
+	}
 	if(linelength) *linelength = LineLengthVector[line];
 	return Script.get() + LineVector[line];
 }
 //---------------------------------------------------------------------------
+tjs_int Parser::GetLineCount() const
+{
+	return static_cast<tjs_int>( EditLines ? EditLines->size() : LineVector.size() );
+}
+//---------------------------------------------------------------------------
+tjs_uint64 Parser::GetLineHash( tjs_int line ) const
+{
+	return EditHashes ? (*EditHashes)[line] : LineHashVector[line];
+}
+//---------------------------------------------------------------------------
 tjs_int Parser::SrcPosToLine(tjs_int pos) const
 {
 	tjs_uint s = 0;
@@ -206,32 +311,34 @@ void Parser::ErrorLog( ttstr message, const ttstr& p1 ) {
 }
 //---------------------------------------------------------------------------
 void Parser::Log( LogType type, const tjs_char* message ) {
-	ttstr typemes;
-	if( type == LogType::Warning ) {
-		typemes = ttstr( TJS_W("warning : ") );
-	} else {
-		typemes = ttstr( TJS_W("error : ") );
-	}
-	tjs_int line = CurrentLine + 1;
-	TVPAddLog( typemes + TJS_W("(") + ttstr(line) + TJS_W(") " + message ) );
+	DiagnosticType diagnostic = type == LogType::Warning ? DiagnosticType::Warning : DiagnosticType::Error;
+	ttstr text = ScenarioData::FormatDiagnostic( diagnostic, CurrentLine, message );
+	TVPAddLog( text );
+	// キャッシュ等から読み込んだ時に再出力できるよう記録しておく
+	if( Scenario ) Scenario->addDiagnostic( diagnostic, CurrentLine, message, text );
+}
+//---------------------------------------------------------------------------
+/** 作業用タグを指定されたタグ名で初期化して返す。使い終わったら release すること。 */
+Tag& Parser::GetWorkTag( const tTJSVariantString* name ) {
+	WorkTag->release();
+	WorkTag->setTagName( name );
+	return *WorkTag.get();
+}
+//---------------------------------------------------------------------------
+/** 作業用タグを追加済みの空のタグに結び付けて返す。使い終わったら release すること。 */
+Tag& Parser::GetWorkTag( tjs_uint32 index ) {
+	WorkTag->bind( Scenario.get(), index );
+	return *WorkTag.get();
 }
 //---------------------------------------------------------------------------
 /** ルビ/文字装飾用スタックをクリアする。 */
 void Parser::ClearRubyDecorationStack() {
 	while( !RubyDecorationStack.empty() ) {
-		RubyDecorationStack.top()->Release();
 		RubyDecorationStack.pop();
 	}
 }
 //---------------------------------------------------------------------------
 /** 指定された名前で現在の辞書の属性(もしくはパラメータ)に値を設定する。 */
-void Parser::PushAttribute( const tTJSVariantString* name, iTJSDispatch2* dic, bool isparameter ) {
-	tTJSVariant tmp( dic, dic );
-	dic->Release();
-	PushAttribute( name, tmp, isparameter );
-}
-//---------------------------------------------------------------------------
-/** 指定された名前で現在の辞書の属性(もしくはパラメータ)に値を設定する。 */
 void Parser::PushAttribute( const tTJSVariantString* name, const tTJSVariant& value, bool isparameter ) {
 	if( isparameter ) {
 		if( CurrentTag->setParameter( name, value ) ) {
@@ -246,21 +353,16 @@ void Parser::PushAttribute( const tTJSVariantString* name, const tTJSVariant& va
 //---------------------------------------------------------------------------
 /** 指定された名前で現在の辞書の属性(もしくはパラメータ)に参照を設定する。 */
 void Parser::PushAttributeReference( const tTJSVariantString& name, const tTJSVariant& value, bool isparameter ) {
-	iTJSDispatch2* ref = TJSCreateDictionaryObject();
-	ref->PropSetByVS( TJS_MEMBERENSURE, GetRWord()->ref(), &value, ref );
-	tTJSVariant tmp(ref,ref);
-	ref->Release();
-	PushAttribute( &name, tmp, isparameter );
+	if( CurrentTag->setReference( &name, value, isparameter ) ) {
+		WarningLog( ( ttstr( name ) + ttstr( TJS_W( " : " ) ) + TVPMdkGetText( isparameter ? NUM_MDK_PARAMETER_DUPLICATE : NUM_MDK_ATTRIBUTE_DUPLICATE ) ).c_str() );
+	}
 }
 //---------------------------------------------------------------------------
 /** 指定された名前で現在の辞書の属性(もしくはパラメータ)にファイルプロパティを設定する。 */
 void Parser::PushAttributeFileProperty( const tTJSVariantString& name, const tTJSVariant& file, const tTJSVariant& prop, bool isparameter ) {
-	iTJSDispatch2* ref = TJSCreateDictionaryObject();
-	ref->PropSetByVS( TJS_MEMBERENSURE, GetRWord()->file(), &file, ref );
-	ref->PropSetByVS( TJS_MEMBERENSURE, GetRWord()->prop(), &prop, ref );
-	tTJSVariant tmp(ref,ref);
-	ref->Release();
-	PushAttribute( &name, tmp, isparameter );
+	if( CurrentTag->setFileProperty( &name, file, ttstr( prop.AsStringNoAddRef() ), isparameter ) ) {
+		WarningLog( ( ttstr( name ) + ttstr( TJS_W( " : " ) ) + TVPMdkGetText( isparameter ? NUM_MDK_PARAMETER_DUPLICATE : NUM_MDK_ATTRIBUTE_DUPLICATE ) ).c_str() );
+	}
 }
 //---------------------------------------------------------------------------
 /**
@@ -500,7 +602,7 @@ void Parser::ParseTag() {
 				if( !MultiLineTag ) {
 					if( !LineAttribute ) {
 						MultiLineTag = true;
-						CurrentTag->createDic();
+						CurrentTag->create();
 					} else {
 						LineAttribute = false;
 					}
@@ -525,9 +627,9 @@ void Parser::ParseTag() {
 				if( ParseSpecialAttribute( token, value ) ) {
 					findtagname = true;
 				} else {
-					ttstr* word = GetTagSignWord( token );
-					if( word != nullptr ) {
-						CurrentTag->addCommand( word->AsVariantStringNoAddRef() );
+					const SignCommand* sign = GetTagSignWord( token );
+					if( sign != nullptr ) {
+						CurrentTag->addSignCommand( sign->Word.AsVariantStringNoAddRef(), sign->Bit );
 						token = Lex->GetInTagToken( value );
 					} else {
 						// unknown symbol
@@ -681,15 +783,18 @@ void Parser::ParseLabel() {
 	CurrentTag->release();
 	CurrentTag->setTagName( GetRWord()->label() );
 
+	ttstr name;
+	ttstr desc;
 	tjs_int value;
 	Token token = Lex->GetInTagToken( value );
 	if( token == Token::SYMBOL || token == Token::VERTLINE ) {
 		if( token == Token::SYMBOL ) {
+			name = ttstr( Lex->GetValue( value ) );
 			CurrentTag->setValue( GetRWord()->name(), Lex->GetValue( value ) );
 			token = Lex->GetInTagToken( value );
 		}
 		if( token == Token::VERTLINE ) {
-			ttstr desc = Lex->GetRemainString();
+			desc = Lex->GetRemainString();
 			if( desc.GetLen() > 0 ) {
 				CurrentTag->setText( GetRWord()->description(), desc );
 			}
@@ -701,6 +806,10 @@ void Parser::ParseLabel() {
 
 	Scenario->setTag( *CurrentTag.get() );
 	CurrentTag->release();
+	// 名前のあるラベルは索引にも追加する
+	if( !name.IsEmpty() ) {
+		Scenario->addLabel( name, desc );
+	}
 }
 //---------------------------------------------------------------------------
 /**
@@ -765,6 +874,7 @@ void Parser::ParseSelect( tjs_int number ) {
 	ParseAttributes();
 
 	Scenario->setTag( *CurrentTag.get() );
+	Scenario->addSelectChoice();
 	CurrentTag->release();
 }
 //---------------------------------------------------------------------------
@@ -814,33 +924,35 @@ bool Parser::ParseTag( Token token, tjs_int value ) {
 
 	switch( token ) {
 	case Token::TEXT:
-		Scenario->addValueToCurrentLine( Lex->GetValue( value ) );
+		Scenario->addTextToCurrentLine( ttstr( Lex->GetValue( value ).AsStringNoAddRef() ) );
 		return true;
 
 	case Token::BEGIN_TAG:
 		ParseTag();
 		return true;
 
-	case Token::VERTLINE: {	// ルビ or 文字装飾
-		iTJSDispatch2* dic = TJSCreateDictionaryObject();
-		RubyDecorationStack.push( dic );
-		tTJSVariant v( dic, dic );
-		Scenario->addValueToCurrentLine( dic );	// 空の辞書を追加しておく
+	case Token::VERTLINE:	// ルビ or 文字装飾
+		RubyDecorationStack.push( Scenario->addEmptyTagToCurrentLine() );	// 空のタグを追加しておく
 		return true;
-	}
+
 	case Token::BEGIN_RUBY: {	// 《が来たので、ルビ文字であるとみなす
 		int text = Lex->ReadToCharStrict( TJS_W( '》') );
 		if( text >= 0 ) {
 			if( !RubyDecorationStack.empty() ) {
 				{	// rubyタグの内容を埋める
-					Tag tag( RubyDecorationStack.top() );
+					tjs_uint32 index = RubyDecorationStack.top();
+					Tag& tag = GetWorkTag( index );
 					RubyDecorationStack.pop();
 					tag.setAttribute( GetRWord()->text(), Lex->GetValue( text ) );
+					ttstr reading( Lex->GetValue( text ) );
+					Scenario->addRuby( index, &reading );
 					tag.setTagName( GetRWord()->ruby() );
+					tag.release();
 				}
 				// [endruby]タグ追加
-				Tag tag( GetRWord()->endruby() );
+				Tag& tag = GetWorkTag( GetRWord()->endruby() );
 				Scenario->addTagToCurrentLine( tag );
+				tag.release();
 			} else {
 				ErrorLog( TVPMdkGetText( NUM_MDK_INVALID_RUBY_SYNTAX ).c_str() );
 			}
@@ -852,13 +964,17 @@ bool Parser::ParseTag( Token token, tjs_int value ) {
 	case Token::END_RUBY: {	// ルビ辞書の可能性
 		if( !RubyDecorationStack.empty() ) {
 			{	// rubyタグの内容を埋める/ text属性がないrubyとして登録する、text属性がない場合は辞書から検索してもらう
-				Tag tag( RubyDecorationStack.top() );
+				tjs_uint32 index = RubyDecorationStack.top();
+				Tag& tag = GetWorkTag( index );
 				RubyDecorationStack.pop();
+				Scenario->addRuby( index, nullptr );
 				tag.setTagName( GetRWord()->ruby() );
+				tag.release();
 			}
 			// [endruby]タグ追加
-			Tag tag( GetRWord()->endruby() );
+			Tag& tag = GetWorkTag( GetRWord()->endruby() );
 			Scenario->addTagToCurrentLine( tag );
+			tag.release();
 		} else {
 			ErrorLog( TVPMdkGetText( NUM_MDK_INVALID_RUBY_SYNTAX ).c_str() );
 		}
@@ -866,19 +982,21 @@ bool Parser::ParseTag( Token token, tjs_int value ) {
 	}
 	case Token::BEGIN_TXT_DECORATION: {	// { が来たので、テキスト装飾であるとみなす
 		if( !RubyDecorationStack.empty() ) {
-			iTJSDispatch2* dic = RubyDecorationStack.top();
+			tjs_uint32 index = RubyDecorationStack.top();
 			RubyDecorationStack.pop();
-			Tag* oldTag = CurrentTag.release();
-			CurrentTag.reset( new Tag( dic ) );
+			// 解析中のタグを退避し、文字装飾用のタグを現在のタグとして属性を解析する
+			DecorationTag->bind( Scenario.get(), index );
+			std::swap( CurrentTag, DecorationTag );
 			CurrentTag->setTagName( GetRWord()->textstyle() );
 			TextAttribute = true;
 			ParseAttributes();
 			TextAttribute = false;
 			CurrentTag->release();
-			CurrentTag.reset( oldTag );
+			std::swap( CurrentTag, DecorationTag );
 			// [endtextstyle]タグ追加
-			Tag tag( GetRWord()->endtextstyle() );
+			Tag& tag = GetWorkTag( GetRWord()->endtextstyle() );
 			Scenario->addTagToCurrentLine( tag );
+			tag.release();
 		} else {
 			ErrorLog( TVPMdkGetText( NUM_MDK_INVALID_CHARACTOR_DECORATION_SYNTAX ).c_str() );
 		}
@@ -886,17 +1004,19 @@ bool Parser::ParseTag( Token token, tjs_int value ) {
 	}
 
 	case Token::WAIT_RETURN: { // l タグ追加
-		Tag tag( GetRWord()->l() );
+		Tag& tag = GetWorkTag( GetRWord()->l() );
 		Scenario->addTagToCurrentLine( tag );
+		tag.release();
 		return true;
 	}
 
 	case Token::INNER_IMAGE: {	// inlineimageタグ追加
 		int text = Lex->ReadToCharStrict( TJS_W( ')' ) );
 		if( text >= 0 ) {
-			Tag tag( GetRWord()->inlineimage() );
+			Tag& tag = GetWorkTag( GetRWord()->inlineimage() );
 			tag.setAttribute( GetRWord()->storage(), Lex->GetValue( text ) );
 			Scenario->addTagToCurrentLine( tag );
+			tag.release();
 		} else {
 			ErrorLog( TVPMdkGetText( NUM_MDK_INVALID_INLINE_GRAPHICS_SYNTAX ).c_str() );
 		}
@@ -905,9 +1025,10 @@ bool Parser::ParseTag( Token token, tjs_int value ) {
 	case Token::COLON: {	// emojiタグ追加
 		int text = Lex->ReadToCharStrict( TJS_W( ':' ) );
 		if( text >= 0 ) {
-			Tag tag( GetRWord()->emoji() );
+			Tag& tag = GetWorkTag( GetRWord()->emoji() );
 			tag.setAttribute( GetRWord()->storage(), Lex->GetValue( text ) );
 			Scenario->addTagToCurrentLine( tag );
+			tag.release();
 		} else {
 			ErrorLog( TVPMdkGetText( NUM_MDK_INVALID_EMOJI_SYNTAX ).c_str() );
 		}
@@ -933,7 +1054,7 @@ bool Parser::ParseTag( Token token, tjs_int value ) {
  * タグや属性は辞書型で
  */
 void Parser::ParseLine( tjs_int line ) {
-	if( static_cast<tjs_uint>( line ) >= LineVector.size() ) return;
+	if( line < 0 || line >= GetLineCount() ) return;
 
 	if( !MultiLineTag ) CurrentTag->release();
 	ClearRubyDecorationStack();
@@ -951,10 +1072,12 @@ void Parser::ParseLine( tjs_int line ) {
 		} else if( HasSelectLine ) {
 			// 直前が選択肢であった場合は、空のオプションを入れる
 			HasSelectLine = false;
-			Tag tag( GetRWord()->selopt() );
+			Tag& tag = GetWorkTag( GetRWord()->selopt() );
 			Scenario->setTag( tag );
+			Scenario->closeSelect();
+			tag.release();
 		} else {
-			Scenario->setValue( 0 );
+			Scenario->setEmpty();
 		}
 	} else {
 		// 字句抽出器に1行分の文字列をコピーし初期化する
@@ -998,6 +1121,7 @@ void Parser::ParseLine( tjs_int line ) {
 					ParseAttributes();
 
 					Scenario->setTag( *CurrentTag.get() );
+					Scenario->closeSelect();
 					CurrentTag->release();
 				}
 				return;
@@ -1007,14 +1131,15 @@ void Parser::ParseLine( tjs_int line ) {
 			switch( token ) {
 			case Token::EOL:
 				// タブのみの行も空行と同じ
-				Scenario->setValue( 0 );
+				Scenario->setEmpty();
 				break;
 
 			case Token::BEGIN_TRANS:
 			{	// >>> 
 				// トランジション開始以降の文字列は無視し、begintransタグを格納するのみ
-				Tag tag( GetRWord()->begintrans() );
+				Tag& tag = GetWorkTag( GetRWord()->begintrans() );
 				Scenario->setTag( tag );
+				tag.release();
 				break;
 			}
 			case Token::END_TRANS:	// <<<
@@ -1068,30 +1193,92 @@ void Parser::ParseLine( tjs_int line ) {
 	}
 }
 //---------------------------------------------------------------------------
+tjs_uint32 Parser::GetLineStateFlags() const {
+	tjs_uint32 flags = 0;
+	if( MultiLineTag ) flags |= static_cast<tjs_uint32>( LineStateFlag::MultiLineTag );
+	if( HasSelectLine ) flags |= static_cast<tjs_uint32>( LineStateFlag::HasSelectLine );
+	return flags;
+}
+//---------------------------------------------------------------------------
+/**
+ * 前回の内部表現の行を現在の行として引き継げるか
+ * 複数行のタグは後の行で内容が埋まるので、その途中や開始の行は引き継がずに解析する
+ */
+bool Parser::CanReuseLine( const ScenarioData& previous, tjs_int line ) const {
+	const tjs_uint32 multiLine = static_cast<tjs_uint32>( LineStateFlag::MultiLineTag );
+	const LineState& in = previous.GetLineState( line );
+	const LineState& out = previous.GetLineState( line + 1 );
+	if( in.Hash != GetLineHash( CurrentLine ) ) return false;
+	if( ( in.Flags & multiLine ) || ( out.Flags & multiLine ) ) return false;
+	if( ( in.Flags & ParserStateFlags ) != GetLineStateFlags() ) return false;
+	if( in.FixTagName == ScenarioData::NoString ) return FixTagName.IsEmpty();
+	return FixTagName == previous.GetString( in.FixTagName );
+}
+//---------------------------------------------------------------------------
 /**
- * 空のシナリオの場合の結果を返す
+ * 引き継いだ行の後の解析状態を、前回の内部表現に記録された状態に戻す
  */
-iTJSDispatch2* Parser::CreateEmptyScenario() {
-	iTJSDispatch2* retDic = TJSCreateDictionaryObject();
-	if( retDic ) {
-		iTJSDispatch2* ar = TJSCreateArrayObject();
-		tTJSVariant tmp( ar, ar );
-		retDic->PropSetByVS( TJS_MEMBERENSURE, GetRWord()->lines(), &tmp, retDic );
-		ar->Release();
+void Parser::RestoreLineState( const ScenarioData& previous, tjs_int line ) {
+	const LineState& state = previous.GetLineState( line );
+	MultiLineTag = false;
+	HasSelectLine = ( state.Flags & static_cast<tjs_uint32>( LineStateFlag::HasSelectLine ) ) != 0;
+	if( state.FixTagName == ScenarioData::NoString ) {
+		FixTagName.Clear();
+	} else {
+		FixTagName = previous.GetString( state.FixTagName );
 	}
-	return retDic;
 }
 //---------------------------------------------------------------------------
 /**
- * 引数で渡された文字列を解析して、文字列として返す。
+ * 前回の内部表現の line 行から最後までを、現在の行以降にまとめて写せる状態か
+ * 行の開始時点の状態(ページ/選択肢のまとまりを含む)が flags と一致し、どのまとまりの途中でもない時に写せる。
+ * ラベルの重複の判定が変わらないかは別に調べること。
  */
-iTJSDispatch2* Parser::ParseText( const tjs_char* text ) {
-	TJS_F_TRACE( "tTJSScriptBlock::ParseText" );
+bool Parser::CanSpliceLines( const ScenarioData& previous, tjs_int line, tjs_uint32 flags ) const {
+	const LineState& in = previous.GetLineState( line );
+	if( in.Flags != flags || ( flags & OpenStateFlags ) ) return false;
+	if( in.FixTagName == ScenarioData::NoString ) return FixTagName.IsEmpty();
+	return FixTagName == previous.GetString( in.FixTagName );
+}
+//---------------------------------------------------------------------------
+/**
+ * 引数で渡された文字列を解析して、内部表現を返す。
+ */
+std::shared_ptr<const ScenarioData> Parser::Parse( const tjs_char* text ) {
+	return Reparse( text, nullptr );
+}
+//---------------------------------------------------------------------------
+/**
+ * 引数で渡された文字列を解析して、内部表現を返す。
+ * previous に行ごとの解析状態が記録されている時は、先頭/末尾から内容の変わっていない行のうち
+ * 開始時点の解析状態も一致する行は解析せずに previous から写す。
+ */
+std::shared_ptr<const ScenarioData> Parser::Reparse( const tjs_char* text, const std::shared_ptr<const ScenarioData>& previous, const Hash128Value* sourceHash ) {
+	return ParseScript( text, previous && previous->HasLineStates() ? previous.get() : nullptr, ParseCheckpoint(), -1, sourceHash );
+}
+//---------------------------------------------------------------------------
+/**
+ * チェックポイントの行から endLine の手前までを解析して、内部表現を返す。
+ */
+std::shared_ptr<const ScenarioData> Parser::ParseFrom( const tjs_char* text, const ParseCheckpoint& checkpoint, tjs_int endLine ) {
+	return ParseScript( text, nullptr, checkpoint, endLine );
+}
+//---------------------------------------------------------------------------
+/**
+ * start の行から endLine の手前までを解析して、内部表現を返す。endLine が負の時は最後まで
+ * 範囲外の行は void となる。endLine の時点で複数行のタグが続いている時は、そのタグが終わるまで解析する。
+ * prev は先頭から最後まで解析する時のみ使う。
+ */
+std::shared_ptr<const ScenarioData> Parser::ParseScript( const tjs_char* text, const ScenarioData* prev, const ParseCheckpoint& start, tjs_int endLine, const Hash128Value* sourceHash ) {
+	TJS_F_TRACE( "tTJSScriptBlock::Parse" );
 
+	ParsedLines.clear();
 	// compiles text and executes its global level scripts.
 	// the script will be compiled as an expression if isexpressn is true.
-	if( !text ) return CreateEmptyScenario();
-	if( !text[0] ) return CreateEmptyScenario();
+	if( !text || !text[0] ) {
+		SourceHash = sourceHash ? *sourceHash : Hash128().Get();
+		return std::make_shared<ScenarioData>();
+	}
 
 	TJS_D( ( TJS_W( "Counting lines ...\n" ) ) )
 
@@ -1099,16 +1286,16 @@ iTJSDispatch2* Parser::ParseText( const tjs_char* text ) {
 	Script.reset( new tjs_char[TJS_strlen( text ) + 1] );
 	TJS_strcpy( Script.get(), text );
 
-	// 各種状態を初期化
-	Lex->Free();
-	CurrentTag.reset( new Tag() );
-	Scenario.reset( new ScenarioDictionary() );
-	ClearRubyDecorationStack();
-	FixTagName.Clear();
-	LineVector.clear();
-	LineLengthVector.clear();
+	BeginParse();
+
+	// 行ごとの状態は先頭から最後まで解析する時のみ使う
+	const bool whole = start.Line <= 0 && endLine < 0;
+	if( !whole ) prev = nullptr;
+	const bool hashLines = whole && ( Option.Incremental || prev );
 
-	// 改行位置を求める
+	// 改行位置を求める。同時に改行を含めたテキスト全体のハッシュを求める(求めてある時は除く)
+	Hash128 source;
+	const bool hashSource = !sourceHash;
 	tjs_char *script = Script.get();
 	tjs_char *ls = script;
 	tjs_char *p = script;
@@ -1116,8 +1303,14 @@ iTJSDispatch2* Parser::ParseText( const tjs_char* text ) {
 		if( *p == TJS_W( '\r' ) || *p == TJS_W( '\n' ) ) {
 			LineVector.push_back( int( ls - script ) );
 			LineLengthVector.push_back( int( p - ls ) );
+			if( hashLines ) {
+				Hash64 h;
+				h.Update( ls, static_cast<tjs_int>( p - ls ) );
+				LineHashVector.push_back( h.Get() );
+			}
 			if( *p == TJS_W( '\r' ) && p[1] == TJS_W( '\n' ) ) p++;
 			p++;
+			if( hashSource ) source.Update( ls, static_cast<tjs_int>( p - ls ) );
 			ls = p;
 		} else {
 			p++;
@@ -1126,37 +1319,243 @@ iTJSDispatch2* Parser::ParseText( const tjs_char* text ) {
 	if( p != ls ) {
 		LineVector.push_back( int( ls - script ) );
 		LineLengthVector.push_back( int( p - ls ) );
+		if( hashLines ) {
+			Hash64 h;
+			h.Update( ls, static_cast<tjs_int>( p - ls ) );
+			LineHashVector.push_back( h.Get() );
+		}
+		if( hashSource ) source.Update( ls, static_cast<tjs_int>( p - ls ) );
+	}
+	SourceHash = hashSource ? source.Get() : *sourceHash;
+
+	// 前回の内部表現と先頭/末尾で内容が一致する行数を求める
+	const tjs_int lineCount = static_cast<tjs_int>( LineVector.size() );
+	tjs_int head = 0;
+	tjs_int tail = 0;
+	if( prev ) {
+		const tjs_int prevCount = prev->GetLineCount();
+		tjs_int limit = std::min( lineCount, prevCount );
+		while( head < limit && prev->GetLineState( head ).Hash == LineHashVector[head] ) head++;
+		while( tail < limit - head && prev->GetLineState( prevCount - 1 - tail ).Hash == LineHashVector[lineCount - 1 - tail] ) tail++;
 	}
+	return ParseLines( prev, start, endLine, head, tail );
+}
+//---------------------------------------------------------------------------
+/**
+ * テキストを改行を含む行に分け、各行の改行を除いた内容のハッシュを求める。改行は解析時と同じく \r, \n, \r\n
+ */
+void Parser::SplitLines( const tjs_char* text, tjs_int length, std::vector<ttstr>& lines, std::vector<tjs_uint64>& hashes ) {
+	lines.clear();
+	hashes.clear();
+	tjs_int ls = 0;
+	for( tjs_int i = 0; i < length; i++ ) {
+		if( text[i] == TJS_W( '\r' ) || text[i] == TJS_W( '\n' ) ) {
+			Hash64 h;
+			h.Update( text + ls, i - ls );
+			hashes.push_back( h.Get() );
+			if( text[i] == TJS_W( '\r' ) && i + 1 < length && text[i + 1] == TJS_W( '\n' ) ) i++;
+			lines.push_back( ttstr( text + ls, i + 1 - ls ) );
+			ls = i + 1;
+		}
+	}
+	if( ls < length ) {
+		Hash64 h;
+		h.Update( text + ls, length - ls );
+		hashes.push_back( h.Get() );
+		lines.push_back( ttstr( text + ls, length - ls ) );
+	}
+}
+//---------------------------------------------------------------------------
+/**
+ * 行単位のテキストを解析する。lines は改行を含む各行、hashes は各行の改行を除いた内容のハッシュ
+ * previous を解析した後に first 行から removed 行を inserted 行に置き換えたものとして、
+ * 置き換えた行の前後は内容を比べずに引き継ぐ候補とし、first の行の付近から解析を再開する
+ */
+std::shared_ptr<const ScenarioData> Parser::ParseEdit( const std::vector<ttstr>& lines, const std::vector<tjs_uint64>& hashes, const std::shared_ptr<const ScenarioData>& previous, tjs_int first, tjs_int removed, tjs_int inserted ) {
+	TJS_F_TRACE( "tTJSScriptBlock::Parse" );
+
+	ParsedLines.clear();
+	BeginParse();
+	EditLines = &lines;
+	EditHashes = &hashes;
+	// テキスト全体のハッシュは求めない
+	SourceHash = Hash128Value();
+
+	const tjs_int lineCount = static_cast<tjs_int>( lines.size() );
+	const bool valid = first >= 0 && removed >= 0 && inserted >= 0 && first + inserted <= lineCount;
+	const ScenarioData* prev = nullptr;
+	if( valid && previous && previous->HasLineStates() && previous->GetLineCount() == lineCount - inserted + removed ) {
+		prev = previous.get();
+	}
+	std::shared_ptr<const ScenarioData> data;
+	try {
+		data = ParseLines( prev, ParseCheckpoint(), -1, prev ? first : 0, prev ? lineCount - first - inserted : 0 );
+	} catch( ... ) {
+		EditLines = nullptr;
+		EditHashes = nullptr;
+		throw;
+	}
+	EditLines = nullptr;
+	EditHashes = nullptr;
+	return data;
+}
+//---------------------------------------------------------------------------
+/**
+ * 解析の開始時に各種状態を初期化する
+ */
+void Parser::BeginParse() {
+	Lex->Free();
+	CurrentTag->release();
+	DecorationTag->release();
+	WorkTag->release();
+	if( !KeepStringPool ) Strings.Clear();
+	Scenario.reset( new ScenarioDictionary( Strings, TagIds.empty() ? nullptr : &TagIds ) );
+	ClearRubyDecorationStack();
+	FixTagName.Clear();
+	LineVector.clear();
+	LineLengthVector.clear();
+	LineHashVector.clear();
+	EditLines = nullptr;
+	EditHashes = nullptr;
+}
+//---------------------------------------------------------------------------
+/**
+ * start の行から endLine の手前までを解析する。先頭の head 行と末尾の tail 行は prev と内容が一致する
+ */
+std::shared_ptr<const ScenarioData> Parser::ParseLines( const ScenarioData* prev, const ParseCheckpoint& start, tjs_int endLine, tjs_int head, tjs_int tail ) {
+	const bool whole = start.Line <= 0 && endLine < 0;
+	const tjs_int lineCount = GetLineCount();
+	Scenario->createLines( lineCount );
+	Scenario->setPlainText( Option.PlainText );
+	Scenario->setRecordDuplicates( whole && Option.Incremental );
 
 	// 解析状態変数を初期化
-	HasSelectLine = false;
+	HasSelectLine = start.HasSelectLine;
+	FixTagName = start.FixTagName;
 	LineAttribute = false;
 	MultiLineTag = false;
 	TextAttribute = false;
 	FirstError.Clear();
 	CompileErrorCount = 0;
 
+	const tjs_int begin = std::max( 0, std::min( start.Line, lineCount ) );
+	const tjs_int end = endLine < 0 ? lineCount : std::max( begin, std::min( endLine, lineCount ) );
+	const tjs_int interval = Option.CheckpointInterval;
+	const bool states = whole && Option.Incremental;
+	tjs_int nextCheckpoint = begin;
+
+	const tjs_int prevCount = prev ? prev->GetLineCount() : 0;
+
+	// 文字列テーブルを引き継げる時は、先頭の一致する行をまとまりの途中でない行までまとめて写す
+	ParsedLines.assign( lineCount, false );
+	tjs_int resume = begin;
+	const bool splice = prev && ( head > 0 || tail > 0 ) && Scenario->shareStrings( *prev );
+	if( splice ) {
+		tjs_int h = head;
+		while( h > 0 && ( prev->GetLineState( h ).Flags & OpenStateFlags ) ) h--;
+		if( h > 0 ) {
+			Scenario->spliceLines( *prev, 0, h, states );
+			if( interval > 0 ) {
+				tjs_int last = Scenario->copyCheckpoints( *prev, h );
+				nextCheckpoint = last < 0 ? 0 : ( last / interval + 1 ) * interval;
+			}
+			RestoreLineState( *prev, h );
+			resume = h;
+		}
+	}
+
 	// 行ごとに解析を行う。
-	for( CurrentLine = 0; static_cast<tjs_uint>(CurrentLine) < LineVector.size(); CurrentLine++ ) {
+	bool spliced = false;
+	tjs_int spliceLine = 0;	// ラベルの重複の判定が変わる時は、そのラベルの行を過ぎてから写す
+	for( CurrentLine = resume; CurrentLine < lineCount && ( CurrentLine < end || MultiLineTag ); CurrentLine++ ) {
 		Scenario->setCurrentLine( CurrentLine );
-		ParseLine( CurrentLine );
+		// 末尾の一致する行で状態も一致した時は、残りの行をまとめて写して終える
+		if( splice && !MultiLineTag && CurrentLine >= lineCount - tail ) {
+			const tjs_int line = CurrentLine - lineCount + prevCount;
+			bool canSplice = false;
+			if( line >= spliceLine && CanSpliceLines( *prev, line, GetLineStateFlags() | Scenario->getOpenFlags() ) ) {
+				const tjs_int conflict = Scenario->findLabelConflict( *prev, resume, line );
+				canSplice = conflict < 0;
+				if( !canSplice ) spliceLine = conflict + 1;
+			}
+			if( canSplice ) {
+				CurrentTag->release();
+				Scenario->spliceLines( *prev, line, prevCount, states );
+				if( states ) Scenario->addLineState( prev->GetLineState( prevCount ) );
+				// チェックポイントは前回の行ごとの状態から作る
+				for( tjs_int i = interval > 0 ? std::max( nextCheckpoint, CurrentLine ) : lineCount; i < lineCount; ) {
+					const LineState& state = prev->GetLineState( i - lineCount + prevCount );
+					if( state.Flags & static_cast<tjs_uint32>( LineStateFlag::MultiLineTag ) ) {
+						i++;
+					} else {
+						Scenario->addCheckpoint( i, state.Flags & ParserStateFlags, state.FixTagName );
+						i = ( i / interval + 1 ) * interval;
+					}
+				}
+				RestoreLineState( *prev, prevCount );
+				spliced = true;
+				break;
+			}
+		}
+		if( states ) {
+			Scenario->addLineState( GetLineHash( CurrentLine ), GetLineStateFlags() | Scenario->getOpenFlags(), FixTagName );
+		}
+		// 複数行のタグの途中ではチェックポイントを作らず、タグが終わった行で作る
+		if( interval > 0 && CurrentLine >= nextCheckpoint && !MultiLineTag ) {
+			Scenario->addCheckpoint( GetLineStateFlags(), FixTagName );
+			nextCheckpoint = ( CurrentLine / interval + 1 ) * interval;
+		}
+		tjs_int line = -1;
+		if( CurrentLine < head ) {
+			line = CurrentLine;
+		} else if( CurrentLine >= lineCount - tail ) {
+			line = CurrentLine - lineCount + prevCount;
+		}
+		if( line >= 0 && CanReuseLine( *prev, line ) ) {
+			CurrentTag->release();
+			Scenario->copyLine( *prev, line );
+			Scenario->copyDiagnostics( *prev, line );
+			RestoreLineState( *prev, line + 1 );
+		} else {
+			ParseLine( CurrentLine );
+			ParsedLines[CurrentLine] = true;
+		}
+	}
+	if( states && !spliced ) {
+		Scenario->addLineState( 0, GetLineStateFlags() | Scenario->getOpenFlags(), FixTagName );
 	}
 	if( MultiLineTag ) {
 		ErrorLog( TVPMdkGetText( NUM_MDK_UNTARMINATED_TAG ).c_str() );
 	}
+	CurrentTag->release();
+	ClearRubyDecorationStack();
 
 	// コンパイルエラーがあった場合は例外を発生させる。
 	if( CompileErrorCount ) {
 		TJS_eTJSCompileError( FirstError );
 	}
 
-	// 解析結果の配列を辞書のlinesキーに入れる。
-	iTJSDispatch2* retDic = TJSCreateDictionaryObject();
-	if( retDic ) {
-		tTJSVariant tmp( Scenario->getArray(), Scenario->getArray() );
-		retDic->PropSetByVS( TJS_MEMBERENSURE, GetRWord()->lines(), &tmp, retDic );
-		Scenario->release();
-	}
-	return retDic;
+	std::shared_ptr<const ScenarioData> data = Scenario->getData();
+	Scenario->release();
+	return data;
+}
+//---------------------------------------------------------------------------
+/**
+ * first から last の行(last < first の時は first の位置)と、その前後に連続する直前の解析で
+ * 引き継がずに解析した行の範囲を求める。
+ */
+void Parser::GetParsedRange( tjs_int first, tjs_int last, tjs_int& begin, tjs_int& end ) const {
+	const tjs_int count = static_cast<tjs_int>( ParsedLines.size() );
+	begin = std::max( 0, std::min( first, count ) );
+	end = std::max( begin - 1, std::min( last, count - 1 ) );
+	while( begin > 0 && ParsedLines[begin - 1] ) begin--;
+	while( end + 1 < count && ParsedLines[end + 1] ) end++;
+}
+//---------------------------------------------------------------------------
+/**
+ * 引数で渡された文字列を解析して、結果の辞書を返す。
+ */
+iTJSDispatch2* Parser::ParseText( const tjs_char* text ) {
+	return ScenarioData::CreateScenario( Parse( text ), Option );
 }
 //---------------------------------------------------------------------------
@@ -23,11 +23,15 @@
 #include "Token.h"
 
 #include "LexicalAnalyzer.h"
+#include "ScenarioData.h"
+#include "StringPool.h"
+#include "Hash.h"
 
 #include <list>
 #include <memory>
 #include <map>
 #include <stack>
+#include <unordered_map>
 
 /**
  * tagは以下のような辞書形式で格納されている
@@ -52,8 +56,24 @@
 		[ "text" ],	// テキストはそのまま格納
 		[ %[name:"tag"] ],	// タグ
 		[ %[name:"ruby",text:"きりきり"], "吉里吉里", %[name:"endruby"] ],
+	],
+	pages : [
+		[ 1, 3 ],	// ページの開始行と終了行(終了行を含む)
+	],
+	labels : %[		// 名前のあるラベルの索引、同名のラベルがある時は先のもの
+		name : %[ line : 0, description : "desc" ],	// 説明がない時は description なし
+	],
+	selects : [		// 連続する選択肢と選択肢オプションのまとまり
+		%[
+			line : 5,	// 最初の選択肢の行
+			end : 7,	// 最後の行(選択肢オプションがある時はその行)
+			choices : [ %[tag:"select", attribute:%[number:1, text:"text", target:"target"]], ... ],
+			selopt : %[tag:"selopt", ...],	// 選択肢オプションがない時は selopt なし
+		],
 	]
 ]
+ * ページはテキストを含む行から始まり、空行の手前の最後の要素がある行で終わる。
+ * テキストを含まないタグのみの行の間にある空行ではページを区切らない。
  * label の時は以下のような辞書形式で行に直接格納されている
 %[
 	tag : "label",
@@ -72,6 +92,53 @@ void
 行の意味番号
 void : コメント行/タグ名固定関係
 0 : 空行
+
+ * signBits 指定時は、タグ名の前の記号(+ - * ! & と AddSignWord で登録したもの)によるコマンドを
+ * sign にビットで格納し、command には残りのコマンドのみを格納する。ビット位置は signWords の順。
+%[
+	tag : "tag name",
+	sign : 1,	// add
+	command : [ "name" ],
+]
+ * registerTags でタグ名を登録した時は、そのタグに登録順の番号が id として格納される。
+%[
+	tag : "tag name",
+	id : 0,
+]
+ * timingFields 指定時は、整数で指定された time/wait/fade (<1000> {300} (500) 等) を attribute ではなくタグに直接格納する。
+%[
+	tag : "tag name",
+	time : 1000,
+	wait : 300,
+	fade : 500,
+]
+ * compactLines 指定時は、void の行(コメント行/タグ名固定関係/複数行タグの途中)を lines に含めず、
+ * 連続する空行は 0 ではなくその行数として1要素にまとめる。
+ * lineNumbers に lines の各要素の元の行番号(0 始まり)を格納する。元の行から要素を探す時は二分探索する。
+%[
+	lines : [ [ "text" ], 2, %[tag:"label"] ],
+	lineNumbers : [ 0, 1, 5 ],
+]
+ * plainText 指定時は、lines と同じ並びで、タグを除いたテキストを連結した表示テキストを texts に、
+ * |親文字《読み》 記法のルビを readings に格納する。テキストのない行は void。
+ * readings の各要素は 親文字の開始位置, 長さ, 読み の順に並べた配列(辞書から引くルビの読みは void)。
+%[
+	lines : [ [ %[tag:"ruby",attribute:%[text:"きりきり"]], "吉里吉里", %[tag:"endruby"], "Zです。", %[tag:"l"] ] ],
+	texts : [ "吉里吉里Zです。" ],
+	readings : [ [ 0, 4, "きりきり" ] ],
+]
+ * incremental 指定時は、行ごとの内容のハッシュと行の開始時点の解析状態(複数行タグ/選択肢/固定タグ名)を記録する。
+ * Reparse に前回の内部表現を渡すと、内容と開始時点の状態が一致する行は解析せずに写し、変更された行と
+ * 状態が変わった行のみ解析する。複数行タグにかかる行は常に解析する。出力は全体を解析した時と同じ。
+ * 先頭/末尾の変更のない行は、ページ等の途中でない行で区切って各表の範囲ごとまとめて写す。
+ * checkpointInterval 指定時は、その行数ごとに解析を再開できる行と状態を checkpoints に格納する。
+ * 複数行のタグの途中になる時は、タグが終わった次の行に作る。line は元の行番号(0 始まり)。
+ * チェックポイントを loadScenarioFrom に渡すとその行から解析する。
+%[
+	checkpoints : [ %[ line : 0 ], %[ line : 100, selectLine : 1, fixTagName : "name" ] ],	// 選択肢の直後/固定タグ名がない時はその要素なし
+]
+ * shareMarkerTags 指定時は、属性もコマンドもないタグ(%[tag:"l"] 等)はタグ名ごとに同じ辞書を共有する。
+ * 共有された辞書は書き換えないこと。
  */
  
 //---------------------------------------------------------------------------
@@ -84,8 +151,24 @@ class Parser
 		Error,
 	};
 
-	std::map<Token,ttstr>			TagCommandPair;
+public:
+	/** タグ名前の記号で指定するコマンド */
+	struct SignCommand {
+		ttstr Word;
+		tjs_uint32 Bit;	// sign に割り当てたビット、割り当てられなかった時は 0
+	};
+
+	/** 解析を再開する行と、その行の開始時点の状態 (チェックポイント) */
+	struct ParseCheckpoint {
+		tjs_int Line = 0;
+		bool HasSelectLine = false;	// 直前の行が選択肢
+		ttstr FixTagName;			// 固定タグ名
+	};
+
+private:
+	std::map<Token,SignCommand>		TagCommandPair;
 	std::map<tjs_char,Token>		SignToToken;
+	std::vector<ttstr>				SignWords;	// ビット位置順のコマンド名
 
 public:
 	Parser();
@@ -104,24 +187,44 @@ private:
 	ttstr FixTagName;
 
 	// tagに必要な要素をクラス化して、管理したほうが間違いが減るな……
+	// 各タグは解析をまたいで使い回し、要素のバッファを再利用する
 	std::unique_ptr<class Tag> CurrentTag;
+	std::unique_ptr<class Tag> DecorationTag;	// 文字装飾 {} の解析中に CurrentTag と入れ替える
+	std::unique_ptr<class Tag> WorkTag;			// 1度に設定し終わるタグ用
 
 	std::unique_ptr<class ScenarioDictionary> Scenario;
 	iTJSDispatch2* ArrayAddFunc = nullptr;
 
-	// ルビ/文字装飾ネスト用スタック
-	std::stack<iTJSDispatch2*> RubyDecorationStack;
+	// 解析結果を TJS2 へ渡す時のオプション
+	ScenarioOption Option;
+
+	// 解析結果の文字列プール、KeepStringPool が true の時は解析をまたいで保持する
+	StringPool Strings;
+	bool KeepStringPool = false;
+
+	// registerTags で登録されたタグ名(プールされた文字列) -> タグ番号
+	std::unordered_map<const tTJSVariantString*, tjs_int32> TagIds;
+
+	// ルビ/文字装飾ネスト用スタック(空のタグのタグ番号)
+	std::stack<tjs_uint32> RubyDecorationStack;
 
 	std::unique_ptr<LexicalAnalyzer> Lex;
 
 	std::vector<tjs_int> LineVector;
 	std::vector<tjs_int> LineLengthVector;
+	std::vector<tjs_uint64> LineHashVector;	// 行の内容のハッシュ、行ごとの状態を使う時のみ
+	const std::vector<ttstr>* EditLines = nullptr;		// ParseEdit の解析中の行単位のテキスト
+	const std::vector<tjs_uint64>* EditHashes = nullptr;	// EditLines の各行の内容のハッシュ
+	Hash128Value SourceHash = { 0, 0 };		// 直前に解析したテキスト全体のハッシュ
+	std::vector<bool> ParsedLines;			// 直前の解析で行を解析したか(false の時は前回の内部表現から写した)
 
 	tTJSString FirstError;
 	tjs_int CompileErrorCount;
 
 public:
 	const tjs_char * GetLine(tjs_int line, tjs_int *linelength) const;
+	tjs_int GetLineCount() const;
+	tjs_uint64 GetLineHash( tjs_int line ) const;
 	tjs_int SrcPosToLine(tjs_int pos) const;
 	tjs_int LineToSrcPos(tjs_int line) const;
 
@@ -137,6 +240,8 @@ public:
 
 	void Initialize();
 	void AddSignWord( tjs_char sign, const ttstr& word );
+	/** ビット位置順の記号コマンド名 */
+	const std::vector<ttstr>& GetSignWords() const { return SignWords; }
 
 private:
 	static void ConsoleOutput(const tjs_char *msg, void *data);
@@ -144,8 +249,11 @@ private:
 	/** ルビ/文字装飾用スタックをクリアする。 */
 	void ClearRubyDecorationStack();
 
-	/** 指定された名前で現在の辞書の属性(もしくはパラメータ)に値を設定する。 */
-	void PushAttribute( const tTJSVariantString* name, iTJSDispatch2* dic, bool isparameter = false );
+	/** 作業用タグを指定されたタグ名で初期化して返す。使い終わったら release すること。 */
+	class Tag& GetWorkTag( const tTJSVariantString* name );
+	/** 作業用タグを追加済みの空のタグに結び付けて返す。使い終わったら release すること。 */
+	class Tag& GetWorkTag( tjs_uint32 index );
+
 	/** 指定された名前で現在の辞書の属性(もしくはパラメータ)に値を設定する。 */
 	void PushAttribute( const tTJSVariantString* name, const tTJSVariant& value, bool isparameter = false );
 
@@ -167,10 +275,84 @@ private:
 	bool ParseTag( Token token, tjs_int value );
 	void ParseLine( tjs_int line );
 
-	ttstr* GetTagSignWord( Token token );
+	/** 現在の解析状態を LineStateFlag のビットで返す */
+	tjs_uint32 GetLineStateFlags() const;
+	/** 前回の内部表現の行を現在の行として引き継げるか */
+	bool CanReuseLine( const ScenarioData& previous, tjs_int line ) const;
+	/** 前回の内部表現に記録された行の開始時点の状態に戻す */
+	void RestoreLineState( const ScenarioData& previous, tjs_int line );
+	/** 前回の内部表現の line 行から最後までを、現在の行以降にまとめて写せる状態か */
+	bool CanSpliceLines( const ScenarioData& previous, tjs_int line, tjs_uint32 flags ) const;
+
+	/** start の行から endLine の手前までを解析する。prev は行を引き継ぐ前回の内部表現 */
+	std::shared_ptr<const ScenarioData> ParseScript( const tjs_char* text, const ScenarioData* prev, const ParseCheckpoint& start, tjs_int endLine, const Hash128Value* sourceHash = nullptr );
+	/** 解析の開始時に各種状態を初期化する */
+	void BeginParse();
+	/** 行に分けた後の解析。先頭の head 行と末尾の tail 行は prev と内容が一致する */
+	std::shared_ptr<const ScenarioData> ParseLines( const ScenarioData* prev, const ParseCheckpoint& start, tjs_int endLine, tjs_int head, tjs_int tail );
+
+	/** 予約語を文字列プールに常駐させる */
+	void AddReservedWords();
+	bool RegisterSignWord( Token token, const ttstr& word );
+	const SignCommand* GetTagSignWord( Token token );
 
-	iTJSDispatch2* CreateEmptyScenario();
 public:
+	ScenarioOption& GetOption() { return Option; }
+	const ScenarioOption& GetOption() const { return Option; }
+
+	/** 文字列プールを次の解析へ持ち越すかどうか */
+	bool GetKeepStringPool() const { return KeepStringPool; }
+	void SetKeepStringPool( bool keep ) {
+		KeepStringPool = keep;
+		if( !keep ) Strings.Clear();
+	}
+	void ClearStringPool() { Strings.Clear(); }
+	/** タグ名を登録し、解析時に登録順の番号を id として格納する。空の時は登録を解除する */
+	void RegisterTags( const std::vector<ttstr>& names );
+	/** 文字列プールから同じ内容の文字列を取得する */
+	const ttstr& InternString( const ttstr& str ) { return Strings.Intern( str ); }
+	tjs_uint GetStringPoolCount() const { return Strings.GetCount(); }
+
+	/** 解析結果に影響する設定(registerTags/記号コマンド/plainText/checkpointInterval)のハッシュ */
+	tjs_uint64 GetSettingsHash() const;
+	/**
+	 * 直前に解析したテキスト全体のハッシュ。改行位置を求める時に同時に求める
+	 * Low は ScenarioBinary::HashSource と同じ値。ParseEdit では求めないので 0 となる
+	 */
+	const Hash128Value& GetSourceHash() const { return SourceHash; }
+	/**
+	 * コンパイル済みのバイナリから内部表現を復元する
+	 * 元のテキストや設定と一致しない時は nullptr を返すので、その時は Parse すること
+	 */
+	std::shared_ptr<const ScenarioData> LoadCompiled( const tjs_uint8* buffer, size_t size, tjs_uint64 sourceHash );
+
+	/** 解析して内部表現を返す */
+	std::shared_ptr<const ScenarioData> Parse( const tjs_char* text );
+	/**
+	 * 前回の内部表現から変更のない行を引き継いで解析する
+	 * previous が incremental 指定で解析したものでない時は Parse と同じ
+	 * sourceHash にテキスト全体のハッシュを求めてある時は、解析時にもう一度求めずにそれを使う
+	 */
+	std::shared_ptr<const ScenarioData> Reparse( const tjs_char* text, const std::shared_ptr<const ScenarioData>& previous, const Hash128Value* sourceHash = nullptr );
+	/**
+	 * チェックポイントの行から解析を始め、endLine の手前までを解析する。endLine が負の時は最後まで
+	 * 範囲外の行は void となり、ページ/ラベル/選択肢は解析した範囲のもののみとなる
+	 */
+	std::shared_ptr<const ScenarioData> ParseFrom( const tjs_char* text, const ParseCheckpoint& checkpoint, tjs_int endLine = -1 );
+	/** テキストを改行を含む行に分け、各行の改行を除いた内容のハッシュを求める */
+	static void SplitLines( const tjs_char* text, tjs_int length, std::vector<ttstr>& lines, std::vector<tjs_uint64>& hashes );
+	/**
+	 * SplitLines で分けた行を解析する。previous を解析した後に first 行から removed 行を inserted 行に置き換えた時は、
+	 * 置き換えた行の前後を previous から引き継ぎ、first の行の付近から状態が一致するまでを解析する
+	 * テキスト全体の連結や改行位置の検索はしない。previous の行数が合わない時は最初から解析する
+	 */
+	std::shared_ptr<const ScenarioData> ParseEdit( const std::vector<ttstr>& lines, const std::vector<tjs_uint64>& hashes, const std::shared_ptr<const ScenarioData>& previous, tjs_int first, tjs_int removed, tjs_int inserted );
+	/**
+	 * 直前の解析で、first から last の行とその前後に連続して解析した行の範囲を返す
+	 * 内容が変わった可能性があるのはこの範囲の行のみ。end < begin の時は該当する行がない
+	 */
+	void GetParsedRange( tjs_int first, tjs_int last, tjs_int& begin, tjs_int& end ) const;
+	/** 解析して結果の辞書を返す */
 	iTJSDispatch2* ParseText( const tjs_char* text );
 };
 //---------------------------------------------------------------------------
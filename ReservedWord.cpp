@@ -19,6 +19,8 @@ ReservedWord::ReservedWord() {
 	attribute_ = TJSMapGlobalStringMap(TJS_W("attribute"));
 	parameter_ = TJSMapGlobalStringMap(TJS_W("parameter"));
 	command_ = TJSMapGlobalStringMap(TJS_W("command"));
+	sign_ = TJSMapGlobalStringMap(TJS_W("sign"));
+	id_ = TJSMapGlobalStringMap(TJS_W("id"));
 	ref_ = TJSMapGlobalStringMap(TJS_W("ref"));
 	file_ = TJSMapGlobalStringMap(TJS_W("file"));
 	prop_ = TJSMapGlobalStringMap(TJS_W("prop"));
@@ -41,6 +43,21 @@ ReservedWord::ReservedWord() {
 	fade_ = TJSMapGlobalStringMap(TJS_W("fade"));
 
 	lines_ = TJSMapGlobalStringMap( TJS_W( "lines" ) );
+	lineNumbers_ = TJSMapGlobalStringMap( TJS_W( "lineNumbers" ) );
+	pages_ = TJSMapGlobalStringMap( TJS_W( "pages" ) );
+	labels_ = TJSMapGlobalStringMap( TJS_W( "labels" ) );
+	line_ = TJSMapGlobalStringMap( TJS_W( "line" ) );
+	selects_ = TJSMapGlobalStringMap( TJS_W( "selects" ) );
+	choices_ = TJSMapGlobalStringMap( TJS_W( "choices" ) );
+	end_ = TJSMapGlobalStringMap( TJS_W( "end" ) );
+	sourceLine_ = TJSMapGlobalStringMap( TJS_W( "sourceLine" ) );
+	sourceEnd_ = TJSMapGlobalStringMap( TJS_W( "sourceEnd" ) );
+	texts_ = TJSMapGlobalStringMap( TJS_W( "texts" ) );
+	readings_ = TJSMapGlobalStringMap( TJS_W( "readings" ) );
+	scenario_ = TJSMapGlobalStringMap( TJS_W( "scenario" ) );
+	checkpoints_ = TJSMapGlobalStringMap( TJS_W( "checkpoints" ) );
+	selectLine_ = TJSMapGlobalStringMap( TJS_W( "selectLine" ) );
+	fixTagName_ = TJSMapGlobalStringMap( TJS_W( "fixTagName" ) );
 
 	ruby_ = TJSMapGlobalStringMap( TJS_W( "ruby" ) );
 	endruby_ = TJSMapGlobalStringMap( TJS_W( "endruby" ) );
@@ -51,6 +68,66 @@ ReservedWord::ReservedWord() {
 	emoji_ = TJSMapGlobalStringMap( TJS_W( "emoji" ) );
 }
 
+void ReservedWord::GetWords( std::vector<ttstr>& words ) const {
+	words.push_back( endtrans_ );
+	words.push_back( begintrans_ );
+	words.push_back( storage_ );
+	words.push_back( type_ );
+	words.push_back( name_ );
+	words.push_back( value_ );
+	words.push_back( tag_ );
+	words.push_back( label_ );
+	words.push_back( select_ );
+	words.push_back( next_ );
+	words.push_back( selopt_ );
+	words.push_back( attribute_ );
+	words.push_back( parameter_ );
+	words.push_back( command_ );
+	words.push_back( sign_ );
+	words.push_back( id_ );
+	words.push_back( ref_ );
+	words.push_back( file_ );
+	words.push_back( prop_ );
+	words.push_back( trans_ );
+	words.push_back( charname_ );
+	words.push_back( alias_ );
+	words.push_back( description_ );
+	words.push_back( text_ );
+	words.push_back( image_ );
+	words.push_back( target_ );
+	words.push_back( if_ );
+	words.push_back( cond_ );
+	words.push_back( comment_ );
+	words.push_back( number_ );
+	words.push_back( voice_ );
+	words.push_back( time_ );
+	words.push_back( wait_ );
+	words.push_back( fade_ );
+	words.push_back( lines_ );
+	words.push_back( lineNumbers_ );
+	words.push_back( pages_ );
+	words.push_back( labels_ );
+	words.push_back( line_ );
+	words.push_back( selects_ );
+	words.push_back( choices_ );
+	words.push_back( end_ );
+	words.push_back( sourceLine_ );
+	words.push_back( sourceEnd_ );
+	words.push_back( texts_ );
+	words.push_back( readings_ );
+	words.push_back( scenario_ );
+	words.push_back( checkpoints_ );
+	words.push_back( selectLine_ );
+	words.push_back( fixTagName_ );
+	words.push_back( ruby_ );
+	words.push_back( endruby_ );
+	words.push_back( l_ );
+	words.push_back( textstyle_ );
+	words.push_back( endtextstyle_ );
+	words.push_back( inlineimage_ );
+	words.push_back( emoji_ );
+}
+
 static ReservedWord* gReservedWord = nullptr;
 void InitializeReservedWord() {
 	if( !gReservedWord ) {
@@ -6,6 +6,7 @@
 #include <windows.h>
 #endif
 #include "tp_stub.h"
+#include <vector>
 
 struct ReservedWord {
 	ttstr endtrans_;
@@ -25,6 +26,8 @@ struct ReservedWord {
 	ttstr attribute_;
 	ttstr parameter_;
 	ttstr command_;
+	ttstr sign_;
+	ttstr id_;
 	ttstr ref_;
 	ttstr file_;
 	ttstr prop_;
@@ -47,6 +50,21 @@ struct ReservedWord {
 	ttstr fade_;
 
 	ttstr lines_;
+	ttstr lineNumbers_;
+	ttstr pages_;
+	ttstr labels_;
+	ttstr line_;
+	ttstr selects_;
+	ttstr choices_;
+	ttstr end_;
+	ttstr sourceLine_;
+	ttstr sourceEnd_;
+	ttstr texts_;
+	ttstr readings_;
+	ttstr scenario_;
+	ttstr checkpoints_;
+	ttstr selectLine_;
+	ttstr fixTagName_;
 
 	ttstr ruby_;
 	ttstr endruby_;
@@ -58,6 +76,9 @@ struct ReservedWord {
 
 	ReservedWord();
 
+	/** 全ての予約語を取得する */
+	void GetWords( std::vector<ttstr>& words ) const;
+
 	tTJSVariantString* endtrans() const { return endtrans_.AsVariantStringNoAddRef(); }
 	tTJSVariantString* begintrans() const { return begintrans_.AsVariantStringNoAddRef(); }
 	tTJSVariantString* storage() const { return storage_.AsVariantStringNoAddRef(); }
@@ -72,6 +93,8 @@ struct ReservedWord {
 	tTJSVariantString* attribute() const { return attribute_.AsVariantStringNoAddRef(); }
 	tTJSVariantString* parameter() const { return parameter_.AsVariantStringNoAddRef(); }
 	tTJSVariantString* command() const { return command_.AsVariantStringNoAddRef(); }
+	tTJSVariantString* sign() const { return sign_.AsVariantStringNoAddRef(); }
+	tTJSVariantString* id() const { return id_.AsVariantStringNoAddRef(); }
 	tTJSVariantString* ref() const { return ref_.AsVariantStringNoAddRef(); }
 	tTJSVariantString* file() const { return file_.AsVariantStringNoAddRef(); }
 	tTJSVariantString* prop() const { return prop_.AsVariantStringNoAddRef(); }
@@ -91,6 +114,21 @@ struct ReservedWord {
 	tTJSVariantString* wait() const { return wait_.AsVariantStringNoAddRef(); }
 	tTJSVariantString* fade() const { return fade_.AsVariantStringNoAddRef(); }
 	tTJSVariantString* lines() const { return lines_.AsVariantStringNoAddRef(); }
+	tTJSVariantString* lineNumbers() const { return lineNumbers_.AsVariantStringNoAddRef(); }
+	tTJSVariantString* pages() const { return pages_.AsVariantStringNoAddRef(); }
+	tTJSVariantString* labels() const { return labels_.AsVariantStringNoAddRef(); }
+	tTJSVariantString* line() const { return line_.AsVariantStringNoAddRef(); }
+	tTJSVariantString* selects() const { return selects_.AsVariantStringNoAddRef(); }
+	tTJSVariantString* choices() const { return choices_.AsVariantStringNoAddRef(); }
+	tTJSVariantString* end() const { return end_.AsVariantStringNoAddRef(); }
+	tTJSVariantString* sourceLine() const { return sourceLine_.AsVariantStringNoAddRef(); }
+	tTJSVariantString* sourceEnd() const { return sourceEnd_.AsVariantStringNoAddRef(); }
+	tTJSVariantString* texts() const { return texts_.AsVariantStringNoAddRef(); }
+	tTJSVariantString* readings() const { return readings_.AsVariantStringNoAddRef(); }
+	tTJSVariantString* scenario() const { return scenario_.AsVariantStringNoAddRef(); }
+	tTJSVariantString* checkpoints() const { return checkpoints_.AsVariantStringNoAddRef(); }
+	tTJSVariantString* selectLine() const { return selectLine_.AsVariantStringNoAddRef(); }
+	tTJSVariantString* fixTagName() const { return fixTagName_.AsVariantStringNoAddRef(); }
 	tTJSVariantString* ruby() const { return ruby_.AsVariantStringNoAddRef(); }
 	tTJSVariantString* endruby() const { return endruby_.AsVariantStringNoAddRef(); }
 	tTJSVariantString* l() const { return l_.AsVariantStringNoAddRef(); }
@@ -0,0 +1,258 @@
+
+#include "ScenarioBinary.h"
+#include "Hash.h"
+#include <string.h>
+
+//---------------------------------------------------------------------------
+namespace {
+
+/** バイナリの書き込み */
+class BinaryWriter {
+	std::vector<tjs_uint8>& Out;
+
+public:
+	BinaryWriter( std::vector<tjs_uint8>& out ) : Out( out ) {}
+
+	void Write( const void* data, size_t size ) {
+		const tjs_uint8* p = static_cast<const tjs_uint8*>( data );
+		Out.insert( Out.end(), p, p + size );
+	}
+	void Write32( tjs_uint32 v ) { Write( &v, sizeof( v ) ); }
+	/** 要素数とレコードをそのまま書き込む */
+	template<typename T>
+	void WriteVector( const RecordTable<T>& table ) {
+		Write32( table.size() );
+		if( !table.empty() ) Write( table.data(), sizeof( T ) * table.size() );
+	}
+	void WriteStrings( const ScenarioData& data ) {
+		tjs_uint32 count = data.GetStringCount();
+		Write32( count );
+		for( tjs_uint32 i = 0; i < count; i++ ) {
+			const ttstr& str = data.GetString( i );
+			Write32( static_cast<tjs_uint32>( str.GetLen() ) );
+			Write( str.c_str(), sizeof( tjs_char ) * str.GetLen() );
+		}
+	}
+};
+
+/** バイナリの読み込み、範囲外を読もうとした時は以降失敗する */
+class BinaryReader {
+	const tjs_uint8* Buffer;
+	size_t Size;
+	size_t Pos = 0;
+	bool Failed = false;
+
+public:
+	BinaryReader( const tjs_uint8* buffer, size_t size ) : Buffer( buffer ), Size( size ) {}
+
+	bool IsFailed() const { return Failed; }
+	bool IsEnd() const { return Pos == Size; }
+	const tjs_uint8* Read( size_t size ) {
+		if( Failed || Size - Pos < size ) {
+			Failed = true;
+			return nullptr;
+		}
+		const tjs_uint8* p = Buffer + Pos;
+		Pos += size;
+		return p;
+	}
+	tjs_uint32 Read32() {
+		tjs_uint32 v = 0;
+		const tjs_uint8* p = Read( sizeof( v ) );
+		if( p ) memcpy( &v, p, sizeof( v ) );
+		return v;
+	}
+	template<typename T>
+	void ReadVector( std::vector<T>& vec ) {
+		tjs_uint32 count = Read32();
+		const tjs_uint8* p = Read( static_cast<size_t>( count ) * sizeof( T ) );
+		if( !p ) return;
+		vec.resize( count );
+		if( count ) memcpy( vec.data(), p, sizeof( T ) * count );
+	}
+	void ReadStrings( std::vector<ttstr>& strings, StringPool& pool ) {
+		tjs_uint32 count = Read32();
+		if( Failed || count > Size - Pos ) {
+			Failed = true;
+			return;
+		}
+		strings.reserve( count );
+		for( tjs_uint32 i = 0; i < count && !Failed; i++ ) {
+			tjs_uint32 len = Read32();
+			const tjs_uint8* p = Read( static_cast<size_t>( len ) * sizeof( tjs_char ) );
+			if( !p ) return;
+			// 境界が揃っているとは限らないのでコピーしてから文字列にする
+			tjs_string str( len, 0 );
+			if( len ) memcpy( &str[0], p, sizeof( tjs_char ) * len );
+			strings.push_back( pool.Intern( ttstr( str.c_str(), static_cast<tjs_int>( len ) ) ) );
+		}
+	}
+};
+
+const tjs_uint8 Magic[4] = { 'M', 'D', 'K', 'C' };
+
+} // namespace
+//---------------------------------------------------------------------------
+tjs_uint32 ScenarioBinary::GetLayout() {
+	Hash64 h;
+	h.Update( static_cast<tjs_uint64>( sizeof( tjs_char ) ) );
+	h.Update( static_cast<tjs_uint64>( sizeof( ValueRecord ) ) );
+	h.Update( static_cast<tjs_uint64>( sizeof( MemberRecord ) ) );
+	h.Update( static_cast<tjs_uint64>( sizeof( TagRecord ) ) );
+	h.Update( static_cast<tjs_uint64>( sizeof( ElementRecord ) ) );
+	h.Update( static_cast<tjs_uint64>( sizeof( LineRecord ) ) );
+	h.Update( static_cast<tjs_uint64>( sizeof( PageRecord ) ) );
+	h.Update( static_cast<tjs_uint64>( sizeof( LabelRecord ) ) );
+	h.Update( static_cast<tjs_uint64>( sizeof( SelectRecord ) ) );
+	h.Update( static_cast<tjs_uint64>( sizeof( TextRecord ) ) );
+	h.Update( static_cast<tjs_uint64>( sizeof( RubyRecord ) ) );
+	h.Update( static_cast<tjs_uint64>( sizeof( CheckpointRecord ) ) );
+	h.Update( static_cast<tjs_uint64>( sizeof( DiagnosticRecord ) ) );
+	return static_cast<tjs_uint32>( h.Get() ^ ( h.Get() >> 32 ) );
+}
+//---------------------------------------------------------------------------
+bool ScenarioBinary::Validate( const ScenarioData& data ) {
+	const size_t strings = data.GetStringCount();
+	auto inRange = []( tjs_uint32 begin, tjs_uint32 count, size_t size ) {
+		return begin <= size && count <= size - begin;
+	};
+	auto validString = [strings]( tjs_uint32 index ) { return index < strings; };
+	auto validLine = [&data]( tjs_uint32 line ) { return line < data.Lines.size(); };
+
+	for( const auto& member : data.Members ) {
+		if( !validString( member.Name ) ) return false;
+		switch( static_cast<ValueType>( member.Value.Type ) ) {
+		case ValueType::String:
+		case ValueType::Reference:
+			if( !validString( member.Value.Index ) ) return false;
+			break;
+		case ValueType::FileProperty:
+			if( !validString( member.Value.Index ) || member.Value.Data < 0 || !validString( static_cast<tjs_uint32>( member.Value.Data ) ) ) return false;
+			break;
+		case ValueType::Octet:
+			if( member.Value.Data < 0 || member.Value.Data > 0xffffffff || !inRange( member.Value.Index, static_cast<tjs_uint32>( member.Value.Data ), data.Octets.size() ) ) return false;
+			break;
+		default:
+			break;
+		}
+	}
+	for( auto command : data.Commands ) {
+		if( !validString( command ) ) return false;
+	}
+	for( const auto& tag : data.Tags ) {
+		if( tag.Name != ScenarioData::NoString && !validString( tag.Name ) ) return false;
+		if( !inRange( tag.MemberBegin, tag.MemberCount, data.Members.size() ) ) return false;
+		if( !inRange( tag.CommandBegin, tag.CommandCount, data.Commands.size() ) ) return false;
+		if( tag.SignCount > tag.CommandCount ) return false;
+	}
+	for( const auto& element : data.Elements ) {
+		if( element.Type == static_cast<tjs_uint32>( ElementType::Text ) ) {
+			if( !validString( element.Index ) ) return false;
+		} else if( element.Index >= data.Tags.size() ) {
+			return false;
+		}
+	}
+	for( const auto& line : data.Lines ) {
+		if( line.Type == static_cast<tjs_uint32>( LineType::Tag ) ) {
+			if( line.Index >= data.Tags.size() ) return false;
+		} else if( line.Type == static_cast<tjs_uint32>( LineType::Elements ) ) {
+			if( !inRange( line.Index, line.Count, data.Elements.size() ) ) return false;
+		}
+	}
+	for( const auto& page : data.Pages ) {
+		if( !validLine( page.Begin ) || !validLine( page.End ) ) return false;
+	}
+	for( const auto& label : data.Labels ) {
+		if( !validString( label.Name ) || !validLine( label.Line ) ) return false;
+		if( label.Description != ScenarioData::NoString && !validString( label.Description ) ) return false;
+	}
+	for( const auto& select : data.Selects ) {
+		if( !validLine( select.Line ) || !validLine( select.End ) ) return false;
+		if( !inRange( select.ChoiceBegin, select.ChoiceCount, data.Choices.size() ) ) return false;
+		if( select.Option != ScenarioData::NoTag && select.Option >= data.Tags.size() ) return false;
+	}
+	for( auto choice : data.Choices ) {
+		if( choice >= data.Tags.size() ) return false;
+	}
+	for( const auto& text : data.Texts ) {
+		if( !validLine( text.Line ) || !validString( text.Text ) ) return false;
+		if( !inRange( text.RubyBegin, text.RubyCount, data.Rubies.size() ) ) return false;
+	}
+	for( const auto& ruby : data.Rubies ) {
+		if( ruby.Reading != ScenarioData::NoString && !validString( ruby.Reading ) ) return false;
+	}
+	for( const auto& checkpoint : data.Checkpoints ) {
+		if( !validLine( checkpoint.Line ) ) return false;
+		if( checkpoint.FixTagName != ScenarioData::NoString && !validString( checkpoint.FixTagName ) ) return false;
+	}
+	for( const auto& diagnostic : data.Diagnostics ) {
+		if( !validString( diagnostic.Message ) || !validString( diagnostic.Text ) ) return false;
+	}
+	return true;
+}
+//---------------------------------------------------------------------------
+tjs_uint64 ScenarioBinary::HashSource( const tjs_char* text, tjs_int length ) {
+	Hash128 h;
+	h.Update( text, length );
+	return h.Get().Low;
+}
+//---------------------------------------------------------------------------
+void ScenarioBinary::Write( const ScenarioData& data, tjs_uint64 sourceHash, tjs_uint64 settingsHash, std::vector<tjs_uint8>& out ) {
+	Header header;
+	memcpy( header.Magic, Magic, sizeof( Magic ) );
+	header.Version = Version;
+	header.Layout = GetLayout();
+	header.Reserved = 0;
+	header.SourceHash = sourceHash;
+	header.SettingsHash = settingsHash;
+
+	BinaryWriter writer( out );
+	writer.Write( &header, sizeof( header ) );
+	writer.WriteStrings( data );
+	writer.WriteVector( data.Octets );
+	writer.WriteVector( data.Members );
+	writer.WriteVector( data.Commands );
+	writer.WriteVector( data.Tags );
+	writer.WriteVector( data.Elements );
+	writer.WriteVector( data.Lines );
+	writer.WriteVector( data.Pages );
+	writer.WriteVector( data.Labels );
+	writer.WriteVector( data.Selects );
+	writer.WriteVector( data.Choices );
+	writer.WriteVector( data.Texts );
+	writer.WriteVector( data.Rubies );
+	writer.WriteVector( data.Checkpoints );
+	writer.WriteVector( data.Diagnostics );
+}
+//---------------------------------------------------------------------------
+std::shared_ptr<ScenarioData> ScenarioBinary::Read( const tjs_uint8* buffer, size_t size, tjs_uint64 sourceHash, tjs_uint64 settingsHash, StringPool& pool ) {
+	if( size < sizeof( Header ) ) return nullptr;
+	Header header;
+	memcpy( &header, buffer, sizeof( header ) );
+	if( memcmp( header.Magic, Magic, sizeof( Magic ) ) != 0 ) return nullptr;
+	if( header.Version != Version || header.Layout != GetLayout() ) return nullptr;
+	if( header.SourceHash != sourceHash || header.SettingsHash != settingsHash ) return nullptr;
+
+	std::shared_ptr<ScenarioData> data( new ScenarioData() );
+	BinaryReader reader( buffer + sizeof( header ), size - sizeof( header ) );
+	reader.ReadStrings( data->Owned.Strings, pool );
+	reader.ReadVector( data->Owned.Octets );
+	reader.ReadVector( data->Owned.Members );
+	reader.ReadVector( data->Owned.Commands );
+	reader.ReadVector( data->Owned.Tags );
+	reader.ReadVector( data->Owned.Elements );
+	reader.ReadVector( data->Owned.Lines );
+	reader.ReadVector( data->Owned.Pages );
+	reader.ReadVector( data->Owned.Labels );
+	reader.ReadVector( data->Owned.Selects );
+	reader.ReadVector( data->Owned.Choices );
+	reader.ReadVector( data->Owned.Texts );
+	reader.ReadVector( data->Owned.Rubies );
+	reader.ReadVector( data->Owned.Checkpoints );
+	reader.ReadVector( data->Owned.Diagnostics );
+	if( reader.IsFailed() || !reader.IsEnd() ) return nullptr;
+	data->Bind();
+	if( !Validate( *data ) ) return nullptr;
+	return data;
+}
+//---------------------------------------------------------------------------
@@ -0,0 +1,53 @@
+/**
+ * 解析済みシナリオの内部表現をバイナリに保存/復元する
+ *
+ * ヘッダに元のテキストのハッシュと解析設定(registerTags/記号コマンド等)のハッシュを持ち、
+ * どちらかが一致しない時は使わずに解析し直す。
+ * レコードは実行環境のバイト順/サイズのまま格納するので、異なる環境間では互換性がない。
+ */
+#ifndef __SCENARIO_BINARY_H__
+#define __SCENARIO_BINARY_H__
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+#include "tp_stub.h"
+#include "ScenarioData.h"
+#include "StringPool.h"
+#include <vector>
+#include <memory>
+
+class ScenarioBinary {
+public:
+	/** 形式のバージョン、レコードの構成を変えた時は上げること */
+	static const tjs_uint32 Version = 3;
+
+	/** ファイルの先頭 */
+	struct Header {
+		tjs_uint8 Magic[4];		// "MDKC"
+		tjs_uint32 Version;
+		tjs_uint32 Layout;		// 文字とレコードのサイズから求めた値
+		tjs_uint32 Reserved;
+		tjs_uint64 SourceHash;	// 元のテキストのハッシュ
+		tjs_uint64 SettingsHash;	// 解析設定のハッシュ
+	};
+
+	/** 文字とレコードのサイズから求めた形式の確認用の値 */
+	static tjs_uint32 GetLayout();
+	/** 元のテキストのハッシュを求める。解析済みの時は Parser::GetSourceHash().Low と同じ */
+	static tjs_uint64 HashSource( const tjs_char* text, tjs_int length );
+	/** シナリオに対応するコンパイル済みファイル名 */
+	static ttstr GetCompiledName( const ttstr& storage ) { return storage + TJS_W( "c" ); }
+
+	/** 内部表現をバイナリにして out に追加する */
+	static void Write( const ScenarioData& data, tjs_uint64 sourceHash, tjs_uint64 settingsHash, std::vector<tjs_uint8>& out );
+	/**
+	 * バイナリから内部表現を復元する。文字列はプールを通す
+	 * 形式が異なる/ハッシュが一致しない/壊れている時は nullptr を返す
+	 */
+	static std::shared_ptr<ScenarioData> Read( const tjs_uint8* buffer, size_t size, tjs_uint64 sourceHash, tjs_uint64 settingsHash, StringPool& pool );
+	/** 復元した内部表現の番号がすべて範囲内か確認する */
+	static bool Validate( const ScenarioData& data );
+};
+
+#endif // __SCENARIO_BINARY_H__
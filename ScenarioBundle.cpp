@@ -0,0 +1,130 @@
+
+#include "ScenarioBundle.h"
+#include "ScenarioBinary.h"
+#include "MappedFile.h"
+#include <string.h>
+#include <stdint.h>
+
+//---------------------------------------------------------------------------
+namespace {
+
+const tjs_uint8 Magic[4] = { 'M', 'D', 'K', 'B' };
+// 索引やセクションの境界
+const size_t Alignment = 8;
+
+void Align( std::vector<tjs_uint8>& out, size_t base ) {
+	while( ( out.size() - base ) % Alignment ) out.push_back( 0 );
+}
+
+} // namespace
+//---------------------------------------------------------------------------
+ScenarioBundle::Writer::Writer( std::vector<tjs_uint8>& out )
+	: Out( out ), Base( out.size() ) {
+	Out.resize( Base + sizeof( Header ), 0 );
+}
+//---------------------------------------------------------------------------
+tjs_uint32 ScenarioBundle::Writer::AddChars( const ttstr& str ) {
+	tjs_string key( str.c_str(), str.GetLen() );
+	auto found = CharOffsets.find( key );
+	if( found != CharOffsets.end() ) return found->second;
+	tjs_uint32 offset = static_cast<tjs_uint32>( Chars.size() );
+	Chars.insert( Chars.end(), str.c_str(), str.c_str() + str.GetLen() );
+	CharOffsets.insert( std::make_pair( key, offset ) );
+	return offset;
+}
+//---------------------------------------------------------------------------
+void ScenarioBundle::Writer::Add( const ttstr& storage, tjs_uint64 sourceHash, const ScenarioData& data ) {
+	tjs_uint32 count = data.GetStringCount();
+	std::vector<StringEntry> strings( count );
+	for( tjs_uint32 i = 0; i < count; i++ ) {
+		const ttstr& str = data.GetString( i );
+		strings[i].Offset = AddChars( str );
+		strings[i].Length = static_cast<tjs_uint32>( str.GetLen() );
+	}
+
+	Align( Out, Base );
+	Entry entry;
+	entry.NameOffset = AddChars( storage );
+	entry.NameLength = static_cast<tjs_uint32>( storage.GetLen() );
+	entry.SourceHash = sourceHash;
+	entry.Offset = Out.size() - Base;
+	Entries.push_back( entry );
+
+	// セクションの位置はバンドルの先頭から
+	const size_t table = Out.size();
+	Out.resize( table + sizeof( ScenarioImage::Section ) * ScenarioImage::SectionCount, 0 );
+	ScenarioImage::Section sections[ScenarioImage::SectionCount] = {};
+	ScenarioImage::WriteSections( data, strings, Out, Base, sections );
+	memcpy( &Out[table], sections, sizeof( sections ) );
+}
+//---------------------------------------------------------------------------
+void ScenarioBundle::Writer::Finish( tjs_uint64 settingsHash ) {
+	Header header;
+	memcpy( header.Magic, Magic, sizeof( Magic ) );
+	header.Version = Version;
+	header.Layout = ScenarioBinary::GetLayout();
+	header.SectionCount = ScenarioImage::SectionCount;
+	header.EntryCount = static_cast<tjs_uint32>( Entries.size() );
+	header.Reserved = 0;
+	header.SettingsHash = settingsHash;
+
+	Align( Out, Base );
+	header.EntryOffset = Out.size() - Base;
+	if( !Entries.empty() ) {
+		const tjs_uint8* p = reinterpret_cast<const tjs_uint8*>( Entries.data() );
+		Out.insert( Out.end(), p, p + sizeof( Entry ) * Entries.size() );
+	}
+	Align( Out, Base );
+	header.CharsOffset = Out.size() - Base;
+	header.CharsCount = Chars.size();
+	if( !Chars.empty() ) {
+		const tjs_uint8* p = reinterpret_cast<const tjs_uint8*>( Chars.data() );
+		Out.insert( Out.end(), p, p + sizeof( tjs_char ) * Chars.size() );
+	}
+	memcpy( &Out[Base], &header, sizeof( header ) );
+}
+//---------------------------------------------------------------------------
+std::shared_ptr<ScenarioBundle> ScenarioBundle::Open( const ttstr& storage ) {
+	std::shared_ptr<MappedFile> file = MappedFile::Open( storage );
+	if( !file ) return nullptr;
+	const tjs_uint8* buffer = file->GetData();
+	size_t size = file->GetSize();
+	if( !buffer || size < sizeof( Header ) || memcmp( buffer, Magic, sizeof( Magic ) ) != 0 ) return nullptr;
+
+	std::shared_ptr<ScenarioBundle> bundle( new ScenarioBundle() );
+	Header& header = bundle->Head;
+	memcpy( &header, buffer, sizeof( header ) );
+	if( header.Version != Version || header.Layout != ScenarioBinary::GetLayout() || header.SectionCount != ScenarioImage::SectionCount ) return nullptr;
+	if( header.EntryOffset > size || header.EntryCount > ( size - header.EntryOffset ) / sizeof( Entry ) ) return nullptr;
+	if( header.CharsOffset > size || header.CharsCount > ( size - header.CharsOffset ) / sizeof( tjs_char ) ) return nullptr;
+	const tjs_uint8* entries = buffer + header.EntryOffset;
+	const tjs_uint8* chars = buffer + header.CharsOffset;
+	if( reinterpret_cast<uintptr_t>( entries ) % alignof( Entry ) || reinterpret_cast<uintptr_t>( chars ) % alignof( tjs_char ) ) return nullptr;
+
+	bundle->File = file;
+	bundle->Entries = reinterpret_cast<const Entry*>( entries );
+	bundle->Chars = reinterpret_cast<const tjs_char*>( chars );
+	for( tjs_uint32 i = 0; i < header.EntryCount; i++ ) {
+		const Entry& entry = bundle->Entries[i];
+		if( entry.NameOffset > header.CharsCount || entry.NameLength > header.CharsCount - entry.NameOffset ) return nullptr;
+		tjs_string name( bundle->Chars + entry.NameOffset, entry.NameLength );
+		bundle->Index[name] = i;
+	}
+	return bundle;
+}
+//---------------------------------------------------------------------------
+const ScenarioBundle::Entry* ScenarioBundle::Find( const ttstr& storage ) const {
+	auto found = Index.find( tjs_string( storage.c_str(), storage.GetLen() ) );
+	if( found == Index.end() ) return nullptr;
+	return &Entries[found->second];
+}
+//---------------------------------------------------------------------------
+std::shared_ptr<ScenarioData> ScenarioBundle::Load( const Entry& entry ) const {
+	const tjs_uint8* buffer = File->GetData();
+	size_t size = File->GetSize();
+	if( entry.Offset > size || size - entry.Offset < sizeof( ScenarioImage::Section ) * ScenarioImage::SectionCount ) return nullptr;
+	ScenarioImage::Section sections[ScenarioImage::SectionCount];
+	memcpy( sections, buffer + entry.Offset, sizeof( sections ) );
+	return ScenarioImage::OpenSections( File, sections, buffer, size, Chars, static_cast<size_t>( Head.CharsCount ) );
+}
+//---------------------------------------------------------------------------
@@ -0,0 +1,88 @@
+/**
+ * 複数のシナリオの解析済みイメージを1つにまとめたバンドル
+ *
+ * ヘッダに続き、シナリオごとにイメージと同じ構成のセクション表とセクションを格納し、
+ * 末尾にストレージ名の索引とすべてのシナリオで共有する文字領域を置く。
+ * 同じ文字列は文字領域に1度だけ格納し、各シナリオの文字列表はその位置を指す。
+ * 開く時はファイルを1度だけマップ(または読み込み)し、シナリオは索引の位置を直接参照する。
+ * 元のテキストは読まないので、その変更は検出しない。解析設定のハッシュはバンドル全体で1つ。
+ */
+#ifndef __SCENARIO_BUNDLE_H__
+#define __SCENARIO_BUNDLE_H__
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+#include "tp_stub.h"
+#include "ScenarioData.h"
+#include "ScenarioImage.h"
+#include <vector>
+#include <memory>
+#include <unordered_map>
+
+class MappedFile;
+
+class ScenarioBundle {
+public:
+	/** 形式のバージョン、構成を変えた時は上げること */
+	static const tjs_uint32 Version = 2;
+
+	/** ファイルの先頭 */
+	struct Header {
+		tjs_uint8 Magic[4];		// "MDKB"
+		tjs_uint32 Version;
+		tjs_uint32 Layout;		// ScenarioBinary::GetLayout
+		tjs_uint32 SectionCount;	// ScenarioImage::SectionCount
+		tjs_uint32 EntryCount;
+		tjs_uint32 Reserved;
+		tjs_uint64 SettingsHash;	// 解析設定のハッシュ
+		tjs_uint64 EntryOffset;	// 索引の位置
+		tjs_uint64 CharsOffset;	// 共有の文字領域の位置
+		tjs_uint64 CharsCount;	// 共有の文字領域の文字数
+	};
+	/** 索引の要素 */
+	struct Entry {
+		tjs_uint32 NameOffset;	// ストレージ名の文字領域中の位置
+		tjs_uint32 NameLength;
+		tjs_uint64 SourceHash;	// 元のテキストのハッシュ
+		tjs_uint64 Offset;		// セクション表の位置
+	};
+
+	/** バンドルを out に書き出す。Add でシナリオを追加し、最後に Finish を呼ぶ */
+	class Writer {
+		std::vector<tjs_uint8>& Out;
+		const size_t Base;
+		std::vector<Entry> Entries;
+		std::vector<tjs_char> Chars;
+		std::unordered_map<tjs_string, tjs_uint32> CharOffsets;
+
+		/** 文字列を共有の文字領域に追加して位置を返す。同じ文字列がある時はその位置 */
+		tjs_uint32 AddChars( const ttstr& str );
+
+	public:
+		Writer( std::vector<tjs_uint8>& out );
+		void Add( const ttstr& storage, tjs_uint64 sourceHash, const ScenarioData& data );
+		void Finish( tjs_uint64 settingsHash );
+	};
+
+	/** バンドルを開く。存在しない/形式が異なる/壊れている時は nullptr */
+	static std::shared_ptr<ScenarioBundle> Open( const ttstr& storage );
+
+	tjs_uint64 GetSettingsHash() const { return Head.SettingsHash; }
+	tjs_uint GetCount() const { return Head.EntryCount; }
+	/** ストレージ名で引く。ない時は nullptr */
+	const Entry* Find( const ttstr& storage ) const;
+	/** バンドル中のイメージを参照する内部表現を返す。壊れている時は nullptr */
+	std::shared_ptr<ScenarioData> Load( const Entry& entry ) const;
+
+private:
+	std::shared_ptr<MappedFile> File;
+	Header Head;
+	const Entry* Entries = nullptr;
+	const tjs_char* Chars = nullptr;
+	std::unordered_map<tjs_string, tjs_uint32> Index;
+
+	ScenarioBundle() {}
+};
+
+#endif // __SCENARIO_BUNDLE_H__
@@ -0,0 +1,101 @@
+/**
+ * 解析済みシナリオの LRU キャッシュ
+ * ストレージ名と元のテキストのハッシュで引き、使用量の合計が上限を超えたら古いものから捨てる
+ * 解析設定(registerTags 等)のハッシュが異なるものは使わない
+ */
+#ifndef __SCENARIO_CACHE_H__
+#define __SCENARIO_CACHE_H__
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+#include "tp_stub.h"
+#include "ScenarioData.h"
+#include <list>
+#include <iterator>
+#include <unordered_map>
+#include <memory>
+
+class ScenarioCache {
+	struct Entry {
+		tjs_string Storage;
+		tjs_uint64 SourceHash;
+		tjs_uint64 SettingsHash;
+		std::shared_ptr<const ScenarioData> Data;
+		size_t Size;
+	};
+	// 先頭ほど最近使ったもの
+	std::list<Entry> Entries;
+	std::unordered_map<tjs_string, std::list<Entry>::iterator> Index;
+	size_t Budget = 0;
+	size_t UsedSize = 0;
+	tjs_uint64 Hits = 0;
+	tjs_uint64 Misses = 0;
+
+	void erase( std::list<Entry>::iterator it ) {
+		UsedSize -= it->Size;
+		Index.erase( it->Storage );
+		Entries.erase( it );
+	}
+	/** 上限に収まるまで古いものから捨てる */
+	void shrink() {
+		while( UsedSize > Budget && !Entries.empty() ) {
+			erase( std::prev( Entries.end() ) );
+		}
+	}
+
+public:
+	/**
+	 * 一致するものがあれば返す。なければ nullptr
+	 * 設定が同じで内容だけが変わっている時は、再解析に使えるよう以前のものを stale に返す
+	 */
+	std::shared_ptr<const ScenarioData> Find( const ttstr& storage, tjs_uint64 sourceHash, tjs_uint64 settingsHash, std::shared_ptr<const ScenarioData>* stale = nullptr ) {
+		auto found = Index.find( tjs_string( storage.c_str() ) );
+		if( found != Index.end() ) {
+			auto it = found->second;
+			if( it->SourceHash == sourceHash && it->SettingsHash == settingsHash ) {
+				Entries.splice( Entries.begin(), Entries, it );
+				Hits++;
+				return it->Data;
+			}
+			if( stale && it->SettingsHash == settingsHash ) *stale = it->Data;
+			// 内容か設定が変わっているので捨てる
+			erase( it );
+		}
+		Misses++;
+		return nullptr;
+	}
+	/** 追加する。上限を超える時は古いものから捨て、単独で上限を超えるものは追加しない */
+	void Add( const ttstr& storage, tjs_uint64 sourceHash, tjs_uint64 settingsHash, const std::shared_ptr<const ScenarioData>& data ) {
+		if( Budget == 0 || !data ) return;
+		tjs_string key( storage.c_str() );
+		auto found = Index.find( key );
+		if( found != Index.end() ) erase( found->second );
+
+		size_t size = data->GetMemorySize();
+		if( size > Budget ) return;
+		Entries.push_front( Entry{ key, sourceHash, settingsHash, data, size } );
+		Index.insert( std::make_pair( key, Entries.begin() ) );
+		UsedSize += size;
+		shrink();
+	}
+	/** すべて捨てる */
+	void Purge() {
+		Entries.clear();
+		Index.clear();
+		UsedSize = 0;
+	}
+
+	/** 使用量の上限(バイト)、0 の時はキャッシュしない */
+	size_t GetBudget() const { return Budget; }
+	void SetBudget( size_t budget ) {
+		Budget = budget;
+		shrink();
+	}
+	size_t GetUsedSize() const { return UsedSize; }
+	tjs_uint GetCount() const { return static_cast<tjs_uint>( Entries.size() ); }
+	tjs_uint64 GetHits() const { return Hits; }
+	tjs_uint64 GetMisses() const { return Misses; }
+};
+
+#endif // __SCENARIO_CACHE_H__
@@ -0,0 +1,685 @@
+
+#include "ScenarioData.h"
+#include "ReservedWord.h"
+#include <string.h>
+#include <algorithm>
+
+//---------------------------------------------------------------------------
+/**
+ * 解析結果の行配列の代わりに lines に入れるオブジェクト
+ * count と行番号での参照のみをサポートし、参照された行のみを生成する。
+ */
+class ScenarioLineArray : public tTJSDispatch {
+	std::shared_ptr<const ScenarioData> Data;
+	ScenarioOption Option;
+	std::vector<LineEntry> Entries;
+	std::vector<tTJSVariant> Lines;
+	std::vector<bool> Created;
+
+	tjs_int GetCount() const { return static_cast<tjs_int>( Entries.size() ); }
+	/** 負数の時は末尾からの位置とし、範囲内かどうかを返す */
+	bool NormalizeIndex( tjs_int& num ) const {
+		if( num < 0 ) num += GetCount();
+		return num >= 0 && num < GetCount();
+	}
+	/** 行を取得する、まだ生成していない時は生成する */
+	const tTJSVariant& GetLine( tjs_int line ) {
+		if( !Created[line] ) {
+			Lines[line] = Data->CreateEntry( Entries[line], Option );
+			Created[line] = true;
+		}
+		return Lines[line];
+	}
+
+public:
+	ScenarioLineArray( const std::shared_ptr<const ScenarioData>& data, const std::vector<LineEntry>& entries, const ScenarioOption& option )
+		: Data( data ), Option( option ), Entries( entries ), Lines( entries.size() ), Created( entries.size(), false ) {}
+
+	tjs_error TJS_INTF_METHOD PropGet( tjs_uint32 flag, const tjs_char* membername, tjs_uint32* hint, tTJSVariant* result, iTJSDispatch2* objthis ) override {
+		if( !membername ) return tTJSDispatch::PropGet( flag, membername, hint, result, objthis );
+		if( TJS_strcmp( membername, TJS_W( "count" ) ) == 0 ) {
+			if( result ) *result = tTJSVariant( GetCount() );
+			return TJS_S_OK;
+		}
+		return TJS_E_MEMBERNOTFOUND;
+	}
+	tjs_error TJS_INTF_METHOD PropGetByNum( tjs_uint32 flag, tjs_int num, tTJSVariant* result, iTJSDispatch2* objthis ) override {
+		if( result ) {
+			if( NormalizeIndex( num ) ) {
+				*result = GetLine( num );
+			} else {
+				result->Clear();
+			}
+		}
+		return TJS_S_OK;
+	}
+	tjs_error TJS_INTF_METHOD PropSetByNum( tjs_uint32 flag, tjs_int num, const tTJSVariant* param, iTJSDispatch2* objthis ) override {
+		if( !param ) return TJS_E_INVALIDPARAM;
+		if( !NormalizeIndex( num ) ) return TJS_E_ACCESSDENYED;
+		Lines[num] = *param;
+		Created[num] = true;
+		return TJS_S_OK;
+	}
+};
+//---------------------------------------------------------------------------
+iTJSDispatch2* SharedTagCache::Get( const ttstr& name, tjs_int32 id ) {
+	// registerTags を変更しても別の辞書となるよう、番号もキーに含める
+	tjs_string key( name.c_str(), name.GetLen() );
+	if( id >= 0 ) {
+		key.push_back( 0 );
+		key.push_back( static_cast<tjs_char>( id & 0xffff ) );
+		key.push_back( static_cast<tjs_char>( ( id >> 16 ) & 0xffff ) );
+	}
+	auto found = Tags.find( key );
+	if( found == Tags.end() ) {
+		iTJSDispatch2* dic = TJSCreateDictionaryObject();
+		tTJSVariant tag( name );
+		dic->PropSetByVS( TJS_MEMBERENSURE, GetRWord()->tag(), &tag, dic );
+		if( id >= 0 ) {
+			tTJSVariant value( static_cast<tjs_int>( id ) );
+			dic->PropSetByVS( TJS_MEMBERENSURE, GetRWord()->id(), &value, dic );
+		}
+		found = Tags.insert( std::make_pair( key, tTJSVariant( dic, dic ) ) ).first;
+		dic->Release();
+	}
+	iTJSDispatch2* dic = found->second.AsObjectNoAddRef();
+	dic->AddRef();
+	return dic;
+}
+//---------------------------------------------------------------------------
+/**
+ * 要素数が確定した値の列から配列を生成する
+ * 1要素ずつ PropSetByNum すると配列が段階的に拡張されるので、push に全要素を渡して一度に追加する
+ */
+static iTJSDispatch2* CreateArray( std::vector<tTJSVariant>& items ) {
+	iTJSDispatch2* ar = TJSCreateArrayObject();
+	if( !items.empty() ) {
+		std::vector<tTJSVariant*> params( items.size() );
+		for( size_t i = 0; i < items.size(); i++ ) {
+			params[i] = &items[i];
+		}
+		ar->FuncCall( 0, TJS_W( "push" ), nullptr, nullptr, static_cast<tjs_int>( params.size() ), params.data(), ar );
+	}
+	return ar;
+}
+//---------------------------------------------------------------------------
+/** 子の辞書を生成して指定された名前で設定する */
+static iTJSDispatch2* CreateChildDictionary( iTJSDispatch2* dic, tTJSVariantString* name ) {
+	iTJSDispatch2* child = TJSCreateDictionaryObject();
+	tTJSVariant tmp( child, child );
+	dic->PropSetByVS( TJS_MEMBERENSURE, name, &tmp, dic );
+	return child;
+}
+//---------------------------------------------------------------------------
+void ScenarioData::Bind() {
+	Octets.Set( Owned.Octets );
+	Members.Set( Owned.Members );
+	Commands.Set( Owned.Commands );
+	Tags.Set( Owned.Tags );
+	Elements.Set( Owned.Elements );
+	Lines.Set( Owned.Lines );
+	Pages.Set( Owned.Pages );
+	Labels.Set( Owned.Labels );
+	Selects.Set( Owned.Selects );
+	Choices.Set( Owned.Choices );
+	Texts.Set( Owned.Texts );
+	Rubies.Set( Owned.Rubies );
+	States.Set( Owned.States );
+	Checkpoints.Set( Owned.Checkpoints );
+	Diagnostics.Set( Owned.Diagnostics );
+}
+//---------------------------------------------------------------------------
+size_t ScenarioData::GetMemorySize() const {
+	size_t size = sizeof( *this );
+	size += Octets.size() * sizeof( tjs_uint8 );
+	size += Members.size() * sizeof( MemberRecord );
+	size += Commands.size() * sizeof( tjs_uint32 );
+	size += Tags.size() * sizeof( TagRecord );
+	size += Elements.size() * sizeof( ElementRecord );
+	size += Lines.size() * sizeof( LineRecord );
+	size += Pages.size() * sizeof( PageRecord );
+	size += Labels.size() * sizeof( LabelRecord );
+	size += Selects.size() * sizeof( SelectRecord );
+	size += Choices.size() * sizeof( tjs_uint32 );
+	size += Texts.size() * sizeof( TextRecord );
+	size += Rubies.size() * sizeof( RubyRecord );
+	size += States.size() * sizeof( LineState );
+	size += Checkpoints.size() * sizeof( CheckpointRecord );
+	size += Diagnostics.size() * sizeof( DiagnosticRecord );
+	size += Owned.DuplicateLabels.size() * sizeof( LabelRecord );
+	tjs_uint32 count = GetStringCount();
+	for( tjs_uint32 i = 0; i < count; i++ ) {
+		tjs_uint32 length = Image ? StringEntries[i].Length : static_cast<tjs_uint32>( Owned.Strings[i].GetLen() );
+		size += sizeof( ttstr ) + sizeof( StringEntry ) + length * sizeof( tjs_char );
+	}
+	return size;
+}
+//---------------------------------------------------------------------------
+ttstr ScenarioData::FormatDiagnostic( DiagnosticType type, tjs_int line, const ttstr& message ) {
+	ttstr typemes;
+	if( type == DiagnosticType::Warning ) {
+		typemes = ttstr( TJS_W("warning : ") );
+	} else {
+		typemes = ttstr( TJS_W("error : ") );
+	}
+	return typemes + TJS_W("(") + ttstr( line + 1 ) + TJS_W(") ") + message;
+}
+//---------------------------------------------------------------------------
+void ScenarioData::LogDiagnostics() const {
+	for( const auto& diagnostic : Diagnostics ) {
+		TVPAddLog( GetString( diagnostic.Text ) );
+	}
+}
+//---------------------------------------------------------------------------
+void ScenarioData::HashString( Hash128& h, tjs_uint32 index ) const {
+	if( index == NoString ) {
+		h.Update( static_cast<tjs_uint64>( NoString ) );
+	} else {
+		h.Update( GetString( index ) );
+	}
+}
+//---------------------------------------------------------------------------
+void ScenarioData::HashValue( Hash128& h, const ValueRecord& value ) const {
+	h.Update( static_cast<tjs_uint64>( value.Type ) );
+	switch( static_cast<ValueType>( value.Type ) ) {
+	case ValueType::Integer:
+	case ValueType::Real:
+		h.Update( static_cast<tjs_uint64>( value.Data ) );
+		break;
+	case ValueType::String:
+	case ValueType::Reference:
+		HashString( h, value.Index );
+		break;
+	case ValueType::FileProperty:
+		HashString( h, value.Index );
+		HashString( h, static_cast<tjs_uint32>( value.Data ) );
+		break;
+	case ValueType::Octet:
+		h.Update( static_cast<tjs_uint64>( value.Data ) );
+		for( tjs_int64 i = 0; i < value.Data; i++ ) {
+			h.Update( static_cast<tjs_uint64>( Octets[value.Index + static_cast<size_t>( i )] ) );
+		}
+		break;
+	default:
+		break;
+	}
+}
+//---------------------------------------------------------------------------
+void ScenarioData::HashTag( Hash128& h, tjs_uint32 index ) const {
+	const TagRecord& tag = Tags[index];
+	HashString( h, tag.Name );
+	h.Update( static_cast<tjs_uint64>( static_cast<tjs_int64>( tag.Id ) ) );
+	h.Update( static_cast<tjs_uint64>( tag.MemberCount ) );
+	for( tjs_uint32 i = 0; i < tag.MemberCount; i++ ) {
+		const MemberRecord& member = Members[tag.MemberBegin + i];
+		h.Update( static_cast<tjs_uint64>( member.Target ) );
+		HashString( h, member.Name );
+		HashValue( h, member.Value );
+	}
+	h.Update( static_cast<tjs_uint64>( tag.CommandCount ) );
+	for( tjs_uint32 i = 0; i < tag.CommandCount; i++ ) {
+		HashString( h, Commands[tag.CommandBegin + i] );
+	}
+	h.Update( static_cast<tjs_uint64>( tag.Signs ) );
+	h.Update( static_cast<tjs_uint64>( tag.SignCount ) );
+	h.Update( static_cast<tjs_uint64>( tag.TimingMask ) );
+	for( int i = 0; i < static_cast<int>( TimingType::Count ); i++ ) {
+		if( tag.TimingMask & ( 1U << i ) ) h.Update( static_cast<tjs_uint64>( static_cast<tjs_int64>( tag.Timings[i] ) ) );
+	}
+}
+//---------------------------------------------------------------------------
+Hash128Value ScenarioData::GetStructureHash() const {
+	Hash128 h;
+	h.Update( static_cast<tjs_uint64>( Lines.size() ) );
+	for( const auto& line : Lines ) {
+		h.Update( static_cast<tjs_uint64>( line.Type ) );
+		switch( static_cast<LineType>( line.Type ) ) {
+		case LineType::Tag:
+			HashTag( h, line.Index );
+			break;
+		case LineType::Elements:
+			h.Update( static_cast<tjs_uint64>( line.Count ) );
+			for( tjs_uint32 i = 0; i < line.Count; i++ ) {
+				const ElementRecord& element = Elements[line.Index + i];
+				h.Update( static_cast<tjs_uint64>( element.Type ) );
+				if( static_cast<ElementType>( element.Type ) == ElementType::Text ) {
+					HashString( h, element.Index );
+				} else {
+					HashTag( h, element.Index );
+				}
+			}
+			break;
+		default:
+			break;
+		}
+	}
+	h.Update( static_cast<tjs_uint64>( Pages.size() ) );
+	for( const auto& page : Pages ) {
+		h.Update( static_cast<tjs_uint64>( page.Begin ) );
+		h.Update( static_cast<tjs_uint64>( page.End ) );
+	}
+	h.Update( static_cast<tjs_uint64>( Labels.size() ) );
+	for( const auto& label : Labels ) {
+		HashString( h, label.Name );
+		HashString( h, label.Description );
+		h.Update( static_cast<tjs_uint64>( label.Line ) );
+	}
+	h.Update( static_cast<tjs_uint64>( Selects.size() ) );
+	for( const auto& select : Selects ) {
+		h.Update( static_cast<tjs_uint64>( select.Line ) );
+		h.Update( static_cast<tjs_uint64>( select.End ) );
+		h.Update( static_cast<tjs_uint64>( select.ChoiceCount ) );
+		for( tjs_uint32 i = 0; i < select.ChoiceCount; i++ ) {
+			HashTag( h, Choices[select.ChoiceBegin + i] );
+		}
+		h.Update( static_cast<tjs_uint64>( select.Option != NoTag ) );
+		if( select.Option != NoTag ) HashTag( h, select.Option );
+	}
+	h.Update( static_cast<tjs_uint64>( Texts.size() ) );
+	for( const auto& text : Texts ) {
+		h.Update( static_cast<tjs_uint64>( text.Line ) );
+		HashString( h, text.Text );
+		h.Update( static_cast<tjs_uint64>( text.RubyCount ) );
+		for( tjs_uint32 i = 0; i < text.RubyCount; i++ ) {
+			const RubyRecord& ruby = Rubies[text.RubyBegin + i];
+			h.Update( static_cast<tjs_uint64>( ruby.Begin ) );
+			h.Update( static_cast<tjs_uint64>( ruby.Length ) );
+			HashString( h, ruby.Reading );
+		}
+	}
+	h.Update( static_cast<tjs_uint64>( Checkpoints.size() ) );
+	for( const auto& checkpoint : Checkpoints ) {
+		h.Update( static_cast<tjs_uint64>( checkpoint.Line ) );
+		h.Update( static_cast<tjs_uint64>( checkpoint.Flags ) );
+		HashString( h, checkpoint.FixTagName );
+	}
+	return h.Get();
+}
+//---------------------------------------------------------------------------
+tTJSVariant ScenarioData::CreateValue( const ValueRecord& value ) const {
+	switch( static_cast<ValueType>( value.Type ) ) {
+	case ValueType::Null:
+		return tTJSVariant( nullptr, nullptr );
+	case ValueType::Integer:
+		return tTJSVariant( static_cast<tTVInteger>( value.Data ) );
+	case ValueType::Real: {
+		tjs_real d;
+		memcpy( &d, &value.Data, sizeof( d ) );
+		return tTJSVariant( d );
+	}
+	case ValueType::String:
+		return tTJSVariant( GetString( value.Index ) );
+	case ValueType::Octet:
+		return tTJSVariant( Octets.data() + value.Index, static_cast<tjs_uint>( value.Data ) );
+	case ValueType::Reference: {
+		iTJSDispatch2* dic = TJSCreateDictionaryObject();
+		tTJSVariant ref( GetString( value.Index ) );
+		dic->PropSetByVS( TJS_MEMBERENSURE, GetRWord()->ref(), &ref, dic );
+		tTJSVariant ret( dic, dic );
+		dic->Release();
+		return ret;
+	}
+	case ValueType::FileProperty: {
+		iTJSDispatch2* dic = TJSCreateDictionaryObject();
+		tTJSVariant file( GetString( value.Index ) );
+		dic->PropSetByVS( TJS_MEMBERENSURE, GetRWord()->file(), &file, dic );
+		tTJSVariant prop( GetString( static_cast<tjs_uint32>( value.Data ) ) );
+		dic->PropSetByVS( TJS_MEMBERENSURE, GetRWord()->prop(), &prop, dic );
+		tTJSVariant ret( dic, dic );
+		dic->Release();
+		return ret;
+	}
+	default:
+		return tTJSVariant();
+	}
+}
+//---------------------------------------------------------------------------
+iTJSDispatch2* ScenarioData::CreateTag( tjs_uint32 index, const ScenarioOption& option ) const {
+	const TagRecord& tag = Tags[index];
+	if( option.SharedTags && tag.Name != NoString && tag.MemberCount == 0 && tag.CommandCount == 0 && tag.TimingMask == 0 ) {
+		return option.SharedTags->Get( GetString( tag.Name ), tag.Id );
+	}
+	iTJSDispatch2* dic = TJSCreateDictionaryObject();
+	if( tag.Name != NoString ) {
+		tTJSVariant name( GetString( tag.Name ) );
+		dic->PropSetByVS( TJS_MEMBERENSURE, GetRWord()->tag(), &name, dic );
+	}
+	if( tag.Id >= 0 ) {
+		tTJSVariant id( static_cast<tjs_int>( tag.Id ) );
+		dic->PropSetByVS( TJS_MEMBERENSURE, GetRWord()->id(), &id, dic );
+	}
+	iTJSDispatch2* attribute = nullptr;
+	iTJSDispatch2* parameter = nullptr;
+	for( tjs_uint32 i = 0; i < tag.MemberCount; i++ ) {
+		const MemberRecord& member = Members[tag.MemberBegin + i];
+		iTJSDispatch2* target = dic;
+		switch( static_cast<MemberTarget>( member.Target ) ) {
+		case MemberTarget::Attribute:
+			if( !attribute ) attribute = CreateChildDictionary( dic, GetRWord()->attribute() );
+			target = attribute;
+			break;
+		case MemberTarget::Parameter:
+			if( !parameter ) parameter = CreateChildDictionary( dic, GetRWord()->parameter() );
+			target = parameter;
+			break;
+		default:
+			break;
+		}
+		tTJSVariant val( CreateValue( member.Value ) );
+		target->PropSetByVS( TJS_MEMBERENSURE, GetString( member.Name ).AsVariantStringNoAddRef(), &val, target );
+	}
+	if( tag.TimingMask ) {
+		tTJSVariantString* timingNames[] = { GetRWord()->time(), GetRWord()->wait(), GetRWord()->fade() };
+		iTJSDispatch2* target = dic;
+		if( !option.TimingFields ) {
+			if( !attribute ) attribute = CreateChildDictionary( dic, GetRWord()->attribute() );
+			target = attribute;
+		}
+		for( int i = 0; i < static_cast<int>( TimingType::Count ); i++ ) {
+			if( tag.TimingMask & ( 1U << i ) ) {
+				tTJSVariant val( static_cast<tjs_int>( tag.Timings[i] ) );
+				target->PropSetByVS( TJS_MEMBERENSURE, timingNames[i], &val, target );
+			}
+		}
+	}
+	if( attribute ) attribute->Release();
+	if( parameter ) parameter->Release();
+
+	tjs_uint32 commandBegin = tag.CommandBegin;
+	tjs_uint32 commandCount = tag.CommandCount;
+	if( option.SignBits && tag.Signs ) {
+		tTJSVariant signs( static_cast<tjs_int>( tag.Signs ) );
+		dic->PropSetByVS( TJS_MEMBERENSURE, GetRWord()->sign(), &signs, dic );
+		commandBegin += tag.SignCount;
+		commandCount -= tag.SignCount;
+	}
+	if( commandCount ) {
+		std::vector<tTJSVariant> items( commandCount );
+		for( tjs_uint32 i = 0; i < commandCount; i++ ) {
+			items[i] = GetString( Commands[commandBegin + i] );
+		}
+		iTJSDispatch2* command = CreateArray( items );
+		tTJSVariant tmp( command, command );
+		dic->PropSetByVS( TJS_MEMBERENSURE, GetRWord()->command(), &tmp, dic );
+		command->Release();
+	}
+	return dic;
+}
+//---------------------------------------------------------------------------
+tTJSVariant ScenarioData::CreateLine( tjs_int line, const ScenarioOption& option ) const {
+	const LineRecord& rec = Lines[line];
+	switch( static_cast<LineType>( rec.Type ) ) {
+	case LineType::Empty:
+		return tTJSVariant( static_cast<tjs_int>( 0 ) );
+
+	case LineType::Tag: {
+		iTJSDispatch2* dic = CreateTag( rec.Index, option );
+		tTJSVariant ret( dic, dic );
+		dic->Release();
+		return ret;
+	}
+	case LineType::Elements: {
+		std::vector<tTJSVariant> items( rec.Count );
+		for( tjs_uint32 i = 0; i < rec.Count; i++ ) {
+			const ElementRecord& element = Elements[rec.Index + i];
+			if( static_cast<ElementType>( element.Type ) == ElementType::Text ) {
+				items[i] = GetString( element.Index );
+			} else {
+				iTJSDispatch2* dic = CreateTag( element.Index, option );
+				items[i] = tTJSVariant( dic, dic );
+				dic->Release();
+			}
+		}
+		iTJSDispatch2* ar = CreateArray( items );
+		tTJSVariant ret( ar, ar );
+		ar->Release();
+		return ret;
+	}
+	default:
+		return tTJSVariant();
+	}
+}
+//---------------------------------------------------------------------------
+void ScenarioData::CreateEntries( const ScenarioOption& option, std::vector<LineEntry>& entries ) const {
+	tjs_int count = GetLineCount();
+	entries.clear();
+	if( !option.CompactLines ) {
+		entries.resize( count );
+		for( tjs_int i = 0; i < count; i++ ) {
+			entries[i].Line = i;
+			entries[i].BlankCount = 0;
+		}
+		return;
+	}
+	for( tjs_int i = 0; i < count; i++ ) {
+		switch( static_cast<LineType>( Lines[i].Type ) ) {
+		case LineType::Void:
+			break;
+		case LineType::Empty:
+			if( !entries.empty() && entries.back().BlankCount > 0 && entries.back().Line + entries.back().BlankCount == i ) {
+				entries.back().BlankCount++;
+			} else {
+				entries.push_back( LineEntry{ i, 1 } );
+			}
+			break;
+		default:
+			entries.push_back( LineEntry{ i, 0 } );
+			break;
+		}
+	}
+}
+//---------------------------------------------------------------------------
+tTJSVariant ScenarioData::CreateEntry( const LineEntry& entry, const ScenarioOption& option ) const {
+	if( entry.BlankCount > 0 ) {
+		if( option.CompactLines ) return tTJSVariant( entry.BlankCount );
+		return tTJSVariant( static_cast<tjs_int>( 0 ) );
+	}
+	return CreateLine( entry.Line, option );
+}
+//---------------------------------------------------------------------------
+iTJSDispatch2* ScenarioData::CreateLines( const std::vector<LineEntry>& entries, const ScenarioOption& option ) const {
+	std::vector<tTJSVariant> items( entries.size() );
+	for( size_t i = 0; i < entries.size(); i++ ) {
+		items[i] = CreateEntry( entries[i], option );
+	}
+	return CreateArray( items );
+}
+//---------------------------------------------------------------------------
+tjs_int ScenarioData::FindEntry( const std::vector<LineEntry>& entries, tjs_int line, const ScenarioOption& option ) {
+	if( !option.CompactLines ) return line;
+	auto it = std::upper_bound( entries.begin(), entries.end(), line,
+		[]( tjs_int l, const LineEntry& e ) { return l < e.Line; } );
+	return static_cast<tjs_int>( it - entries.begin() ) - 1;
+}
+//---------------------------------------------------------------------------
+void ScenarioData::FindEntryRange( const std::vector<LineEntry>& entries, tjs_int first, tjs_int last, const ScenarioOption& option, tjs_int& begin, tjs_int& end ) {
+	if( !option.CompactLines ) {
+		begin = first;
+		end = last;
+		return;
+	}
+	// 範囲にかかる要素と、範囲に隣接する空行の要素(前後の空行とまとまりが変わりうる)
+	const tjs_int count = static_cast<tjs_int>( entries.size() );
+	begin = std::max<tjs_int>( 0, FindEntry( entries, first - 1, option ) );
+	while( begin < count ) {
+		const LineEntry& entry = entries[begin];
+		if( entry.Line + std::max<tjs_int>( entry.BlankCount, 1 ) > ( entry.BlankCount ? first - 1 : first ) ) break;
+		begin++;
+	}
+	end = FindEntry( entries, last + 1, option );
+	while( end >= begin && entries[end].Line > ( entries[end].BlankCount ? last + 1 : last ) ) end--;
+}
+//---------------------------------------------------------------------------
+iTJSDispatch2* ScenarioData::CreatePages( const std::vector<LineEntry>& entries, const ScenarioOption& option ) const {
+	std::vector<tTJSVariant> items( Pages.size() );
+	for( size_t i = 0; i < Pages.size(); i++ ) {
+		std::vector<tTJSVariant> range( 2 );
+		range[0] = tTJSVariant( FindEntry( entries, static_cast<tjs_int>( Pages[i].Begin ), option ) );
+		range[1] = tTJSVariant( FindEntry( entries, static_cast<tjs_int>( Pages[i].End ), option ) );
+		iTJSDispatch2* ar = CreateArray( range );
+		items[i] = tTJSVariant( ar, ar );
+		ar->Release();
+	}
+	return CreateArray( items );
+}
+//---------------------------------------------------------------------------
+iTJSDispatch2* ScenarioData::CreateLabels( const std::vector<LineEntry>& entries, const ScenarioOption& option ) const {
+	iTJSDispatch2* labels = TJSCreateDictionaryObject();
+	for( const auto& label : Labels ) {
+		iTJSDispatch2* dic = TJSCreateDictionaryObject();
+		tTJSVariant line( FindEntry( entries, static_cast<tjs_int>( label.Line ), option ) );
+		dic->PropSetByVS( TJS_MEMBERENSURE, GetRWord()->line(), &line, dic );
+		if( label.Description != NoString ) {
+			tTJSVariant desc( GetString( label.Description ) );
+			dic->PropSetByVS( TJS_MEMBERENSURE, GetRWord()->description(), &desc, dic );
+		}
+		tTJSVariant tmp( dic, dic );
+		dic->Release();
+		labels->PropSetByVS( TJS_MEMBERENSURE, GetString( label.Name ).AsVariantStringNoAddRef(), &tmp, labels );
+	}
+	return labels;
+}
+//---------------------------------------------------------------------------
+iTJSDispatch2* ScenarioData::CreateSelects( const std::vector<LineEntry>& entries, const ScenarioOption& option ) const {
+	std::vector<tTJSVariant> items( Selects.size() );
+	for( size_t i = 0; i < Selects.size(); i++ ) {
+		const SelectRecord& select = Selects[i];
+		iTJSDispatch2* dic = TJSCreateDictionaryObject();
+		tTJSVariant tmp( FindEntry( entries, static_cast<tjs_int>( select.Line ), option ) );
+		dic->PropSetByVS( TJS_MEMBERENSURE, GetRWord()->line(), &tmp, dic );
+		tmp = tTJSVariant( FindEntry( entries, static_cast<tjs_int>( select.End ), option ) );
+		dic->PropSetByVS( TJS_MEMBERENSURE, GetRWord()->end(), &tmp, dic );
+
+		std::vector<tTJSVariant> choices( select.ChoiceCount );
+		for( tjs_uint32 c = 0; c < select.ChoiceCount; c++ ) {
+			iTJSDispatch2* tag = CreateTag( Choices[select.ChoiceBegin + c], option );
+			choices[c] = tTJSVariant( tag, tag );
+			tag->Release();
+		}
+		iTJSDispatch2* ar = CreateArray( choices );
+		tmp = tTJSVariant( ar, ar );
+		ar->Release();
+		dic->PropSetByVS( TJS_MEMBERENSURE, GetRWord()->choices(), &tmp, dic );
+
+		if( select.Option != NoTag ) {
+			iTJSDispatch2* tag = CreateTag( select.Option, option );
+			tmp = tTJSVariant( tag, tag );
+			tag->Release();
+			dic->PropSetByVS( TJS_MEMBERENSURE, GetRWord()->selopt(), &tmp, dic );
+		}
+		items[i] = tTJSVariant( dic, dic );
+		dic->Release();
+	}
+	return CreateArray( items );
+}
+//---------------------------------------------------------------------------
+void ScenarioData::CreateTexts( const std::vector<LineEntry>& entries, const ScenarioOption& option, iTJSDispatch2*& texts, iTJSDispatch2*& readings ) const {
+	std::vector<tTJSVariant> textItems( entries.size() );
+	std::vector<tTJSVariant> readingItems( entries.size() );
+	for( const auto& text : Texts ) {
+		tjs_int entry = FindEntry( entries, static_cast<tjs_int>( text.Line ), option );
+		textItems[entry] = tTJSVariant( GetString( text.Text ) );
+		if( text.RubyCount ) {
+			// 親文字の開始位置, 長さ, 読み を順に並べる
+			std::vector<tTJSVariant> ruby( text.RubyCount * 3 );
+			for( tjs_uint32 i = 0; i < text.RubyCount; i++ ) {
+				const RubyRecord& rec = Rubies[text.RubyBegin + i];
+				ruby[i*3+0] = tTJSVariant( static_cast<tjs_int>( rec.Begin ) );
+				ruby[i*3+1] = tTJSVariant( static_cast<tjs_int>( rec.Length ) );
+				if( rec.Reading != NoString ) ruby[i*3+2] = tTJSVariant( GetString( rec.Reading ) );
+			}
+			iTJSDispatch2* ar = CreateArray( ruby );
+			readingItems[entry] = tTJSVariant( ar, ar );
+			ar->Release();
+		}
+	}
+	texts = CreateArray( textItems );
+	readings = CreateArray( readingItems );
+}
+//---------------------------------------------------------------------------
+iTJSDispatch2* ScenarioData::CreateCheckpoints() const {
+	std::vector<tTJSVariant> items( Checkpoints.size() );
+	for( size_t i = 0; i < Checkpoints.size(); i++ ) {
+		const CheckpointRecord& checkpoint = Checkpoints[i];
+		iTJSDispatch2* dic = TJSCreateDictionaryObject();
+		tTJSVariant tmp( static_cast<tjs_int>( checkpoint.Line ) );
+		dic->PropSetByVS( TJS_MEMBERENSURE, GetRWord()->line(), &tmp, dic );
+		if( checkpoint.Flags & static_cast<tjs_uint32>( LineStateFlag::HasSelectLine ) ) {
+			tmp = tTJSVariant( static_cast<tjs_int>( 1 ) );
+			dic->PropSetByVS( TJS_MEMBERENSURE, GetRWord()->selectLine(), &tmp, dic );
+		}
+		if( checkpoint.FixTagName != NoString ) {
+			tmp = tTJSVariant( GetString( checkpoint.FixTagName ) );
+			dic->PropSetByVS( TJS_MEMBERENSURE, GetRWord()->fixTagName(), &tmp, dic );
+		}
+		items[i] = tTJSVariant( dic, dic );
+		dic->Release();
+	}
+	return CreateArray( items );
+}
+//---------------------------------------------------------------------------
+iTJSDispatch2* ScenarioData::CreateScenario( const std::shared_ptr<const ScenarioData>& data, const ScenarioOption& option ) {
+	iTJSDispatch2* retDic = TJSCreateDictionaryObject();
+	if( retDic ) {
+		std::vector<LineEntry> entries;
+		data->CreateEntries( option, entries );
+
+		iTJSDispatch2* lines;
+		if( option.Lazy ) {
+			lines = new ScenarioLineArray( data, entries, option );
+		} else {
+			lines = data->CreateLines( entries, option );
+		}
+		tTJSVariant tmp( lines, lines );
+		lines->Release();
+		retDic->PropSetByVS( TJS_MEMBERENSURE, GetRWord()->lines(), &tmp, retDic );
+
+		iTJSDispatch2* pages = data->CreatePages( entries, option );
+		tmp = tTJSVariant( pages, pages );
+		pages->Release();
+		retDic->PropSetByVS( TJS_MEMBERENSURE, GetRWord()->pages(), &tmp, retDic );
+
+		iTJSDispatch2* labels = data->CreateLabels( entries, option );
+		tmp = tTJSVariant( labels, labels );
+		labels->Release();
+		retDic->PropSetByVS( TJS_MEMBERENSURE, GetRWord()->labels(), &tmp, retDic );
+
+		iTJSDispatch2* selects = data->CreateSelects( entries, option );
+		tmp = tTJSVariant( selects, selects );
+		selects->Release();
+		retDic->PropSetByVS( TJS_MEMBERENSURE, GetRWord()->selects(), &tmp, retDic );
+
+		if( option.PlainText ) {
+			iTJSDispatch2* texts;
+			iTJSDispatch2* readings;
+			data->CreateTexts( entries, option, texts, readings );
+			tmp = tTJSVariant( texts, texts );
+			texts->Release();
+			retDic->PropSetByVS( TJS_MEMBERENSURE, GetRWord()->texts(), &tmp, retDic );
+			tmp = tTJSVariant( readings, readings );
+			readings->Release();
+			retDic->PropSetByVS( TJS_MEMBERENSURE, GetRWord()->readings(), &tmp, retDic );
+		}
+
+		if( !data->Checkpoints.empty() ) {
+			iTJSDispatch2* checkpoints = data->CreateCheckpoints();
+			tmp = tTJSVariant( checkpoints, checkpoints );
+			checkpoints->Release();
+			retDic->PropSetByVS( TJS_MEMBERENSURE, GetRWord()->checkpoints(), &tmp, retDic );
+		}
+
+		if( option.CompactLines ) {
+			// lines の各要素の元の行番号
+			std::vector<tTJSVariant> numbers( entries.size() );
+			for( size_t i = 0; i < entries.size(); i++ ) {
+				numbers[i] = tTJSVariant( entries[i].Line );
+			}
+			iTJSDispatch2* ar = CreateArray( numbers );
+			tTJSVariant val( ar, ar );
+			ar->Release();
+			retDic->PropSetByVS( TJS_MEMBERENSURE, GetRWord()->lineNumbers(), &val, retDic );
+		}
+	}
+	return retDic;
+}
+//---------------------------------------------------------------------------
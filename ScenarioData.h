@@ -0,0 +1,391 @@
+/**
+ * 解析済みシナリオの内部表現
+ *
+ * 解析結果は辞書や配列を直接生成せず、固定長レコードの配列と文字列テーブルとして保持する。
+ * TJS2側へはここから辞書/配列を生成して渡す。
+ * 遅延生成時は、行が参照された時点でその行の辞書/配列を生成する。
+ */
+#ifndef __SCENARIO_DATA_H__
+#define __SCENARIO_DATA_H__
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+#include "tp_stub.h"
+#include "Hash.h"
+#include <vector>
+#include <memory>
+#include <unordered_map>
+
+/** 値の型 */
+enum class ValueType : tjs_uint32 {
+	Void = 0,
+	Null,			// null オブジェクト
+	Integer,
+	Real,
+	String,
+	Octet,
+	Reference,		// %[ ref : "name" ]
+	FileProperty,	// %[ file : "name", prop : "name" ]
+};
+/** 値 */
+struct ValueRecord {
+	tjs_uint32 Type;	// ValueType
+	tjs_uint32 Index;	// String/Reference/FileProperty : 文字列番号, Octet : オクテット列の開始位置
+	tjs_int64 Data;		// Integer : 値, Real : ビット列, Octet : 長さ, FileProperty : prop の文字列番号
+};
+
+/** タグのメンバーの格納先 */
+enum class MemberTarget : tjs_uint32 {
+	Attribute = 0,	// attribute 辞書
+	Parameter,		// parameter 辞書
+	Field,			// タグの辞書に直接格納(label の name/description)
+};
+/** 整数で指定された時に固定のフィールドに格納する属性 <time> {wait} (fade) */
+enum class TimingType : tjs_uint32 {
+	Time = 0,
+	Wait,
+	Fade,
+	Count
+};
+/** タグのメンバー */
+struct MemberRecord {
+	tjs_uint32 Target;	// MemberTarget
+	tjs_uint32 Name;	// 文字列番号
+	ValueRecord Value;
+};
+
+/** タグ */
+struct TagRecord {
+	tjs_uint32 Name;			// タグ名の文字列番号、タグ名がない時は NoString
+	tjs_int32 Id;				// 登録されたタグ名の番号、登録されていない時は -1
+	tjs_uint32 MemberBegin;
+	tjs_uint32 MemberCount;
+	tjs_uint32 CommandBegin;
+	tjs_uint32 CommandCount;
+	tjs_uint32 Signs;			// 記号コマンドのビット
+	tjs_uint32 SignCount;		// コマンドの先頭から何個が Signs で表されているか
+	tjs_uint32 TimingMask;		// Timings に値があるかどうかのビット (1 << TimingType)
+	tjs_int32 Timings[static_cast<int>( TimingType::Count )];
+};
+
+/** 行配列の要素の型 */
+enum class ElementType : tjs_uint32 {
+	Text = 0,
+	Tag,
+};
+/** 行配列の要素 */
+struct ElementRecord {
+	tjs_uint32 Type;	// ElementType
+	tjs_uint32 Index;	// Text : 文字列番号, Tag : タグ番号
+};
+
+/** 行の型 */
+enum class LineType : tjs_uint32 {
+	Void = 0,	// void : コメント行/タグ名固定関係/複数行タグの途中
+	Empty,		// 0 : 空行
+	Tag,		// 行に直接タグを格納
+	Elements,	// テキストとタグの配列
+};
+/** 行 */
+struct LineRecord {
+	tjs_uint32 Type;	// LineType
+	tjs_uint32 Index;	// Tag : タグ番号, Elements : 要素の開始位置
+	tjs_uint32 Count;	// Elements : 要素数
+};
+
+/** ページ : テキストを含む行から空行の手前まで。タグのみの行の間の空行は区切りとしない */
+struct PageRecord {
+	tjs_uint32 Begin;	// 最初のテキストがある行
+	tjs_uint32 End;		// 空行の手前の最後の要素がある行(この行を含む)
+};
+
+/** ラベル */
+struct LabelRecord {
+	tjs_uint32 Name;		// ラベル名の文字列番号
+	tjs_uint32 Description;	// 説明の文字列番号、説明がない時は NoString
+	tjs_uint32 Line;		// ラベルのある行
+};
+
+/** 選択肢のまとまり : 連続する選択肢の行とその後の選択肢オプションの行 */
+struct SelectRecord {
+	tjs_uint32 Line;		// 最初の選択肢の行
+	tjs_uint32 End;			// 最後の行(選択肢オプションがある時はその行)
+	tjs_uint32 ChoiceBegin;	// Choices の開始位置
+	tjs_uint32 ChoiceCount;
+	tjs_uint32 Option;		// 選択肢オプションのタグ番号、ない時は NoTag
+};
+
+/** ルビ : 表示テキスト中の親文字の範囲と読み */
+struct RubyRecord {
+	tjs_uint32 Begin;	// 表示テキスト中の親文字の開始位置
+	tjs_uint32 Length;	// 親文字の長さ
+	tjs_uint32 Reading;	// 読みの文字列番号、辞書から引くルビの時は NoString
+};
+/** 1行分の表示テキスト : タグを除いたテキストを連結したもの */
+struct TextRecord {
+	tjs_uint32 Line;
+	tjs_uint32 Text;		// 文字列番号
+	tjs_uint32 RubyBegin;	// Rubies の開始位置
+	tjs_uint32 RubyCount;
+};
+
+/** 行の開始時点の解析状態のビット */
+enum class LineStateFlag : tjs_uint32 {
+	MultiLineTag = 1,	// 複数行のタグの途中
+	HasSelectLine = 2,	// 直前の行が選択肢
+	OpenPage = 4,		// ページの途中(行の状態のみ)
+	OpenSelect = 8,		// 選択肢のまとまりの途中(行の状態のみ)
+};
+/** 行の内容のハッシュと、その行の開始時点の解析状態。再解析時に変更のない行を引き継ぐのに使う */
+struct LineState {
+	tjs_uint64 Hash;		// 行の内容のハッシュ
+	tjs_uint32 Flags;		// LineStateFlag
+	tjs_uint32 FixTagName;	// 固定タグ名の文字列番号、ない時は NoString
+};
+
+/**
+ * チェックポイント : 解析を再開できる行と、その行の開始時点の解析状態
+ * 行頭で初期化される状態(LineAttribute/ルビ/文字装飾のスタック)は含めない。
+ * 複数行のタグの途中では作らないので、解析中のタグも持たない。
+ */
+struct CheckpointRecord {
+	tjs_uint32 Line;
+	tjs_uint32 Flags;		// LineStateFlag
+	tjs_uint32 FixTagName;	// 固定タグ名の文字列番号、ない時は NoString
+};
+
+/** 診断の種類 */
+enum class DiagnosticType : tjs_uint32 {
+	Warning = 0,
+	Error,
+};
+/** 解析時に出力した警告/エラー。キャッシュやコンパイル済みファイルから読み込んだ時に再出力する */
+struct DiagnosticRecord {
+	tjs_uint32 Type;	// DiagnosticType
+	tjs_uint32 Line;	// 出力した時の行
+	tjs_uint32 Message;	// メッセージの文字列番号
+	tjs_uint32 Text;	// 種類と行番号を付けたログの文字列番号
+};
+
+/** イメージの文字列表の要素 : 文字領域中の位置と長さ(文字数) */
+struct StringEntry {
+	tjs_uint32 Offset;
+	tjs_uint32 Length;
+};
+
+/**
+ * レコード配列の参照
+ * 構築した std::vector か、マップしたイメージ中の領域を指す
+ */
+template<typename T>
+class RecordTable {
+	const T* Data = nullptr;
+	tjs_uint32 Count = 0;
+
+public:
+	void Set( const T* data, tjs_uint32 count ) {
+		Data = data;
+		Count = count;
+	}
+	void Set( const std::vector<T>& vec ) {
+		Set( vec.empty() ? nullptr : vec.data(), static_cast<tjs_uint32>( vec.size() ) );
+	}
+	tjs_uint32 size() const { return Count; }
+	bool empty() const { return Count == 0; }
+	const T* data() const { return Data; }
+	const T* begin() const { return Data; }
+	const T* end() const { return Data + Count; }
+	const T& operator[]( size_t index ) const { return Data[index]; }
+};
+
+/**
+ * TJS2 へ渡す lines の1要素
+ * 通常は1行が1要素となる。compactLines 指定時は void の行は除き、連続する空行は1要素にまとめる
+ */
+struct LineEntry {
+	tjs_int Line;		// 元の行番号(連続する空行の時は先頭行)
+	tjs_int BlankCount;	// 連続する空行の時はその行数、それ以外は 0
+};
+
+/**
+ * 属性を持たないタグ([l] や [endruby] 等)の共有辞書
+ * タグ名と registerTags の番号ごとに1つだけ辞書を生成し、以降は同じ辞書を返す。
+ * 共有されるため、受け取った側で書き換えてはならない。
+ */
+class SharedTagCache {
+	std::unordered_map<tjs_string, tTJSVariant> Tags;
+
+public:
+	/** タグ名に対応する辞書を取得する、参照カウンタを加算して返す。id が 0 以上の時は id も格納する */
+	iTJSDispatch2* Get( const ttstr& name, tjs_int32 id );
+	void Clear() { Tags.clear(); }
+};
+
+/** 解析結果を TJS2 へ渡す時のオプション */
+struct ScenarioOption {
+	bool Lazy = false;	// 行が参照された時に辞書/配列を生成する
+	bool SignBits = false;	// 記号コマンドを command ではなく sign にビットで格納する
+	bool TimingFields = false;	// time/wait/fade を attribute ではなくタグに直接格納する
+	bool CompactLines = false;	// void の行を除き、連続する空行をまとめる
+	bool PlainText = false;	// 行ごとの表示テキストとルビを出力する
+	bool Incremental = false;	// 行ごとのハッシュと解析状態を記録し、再解析時に変更のない行を引き継ぐ
+	tjs_int CheckpointInterval = 0;	// 0 より大きい時は、この行数ごとにチェックポイントを記録する
+	std::shared_ptr<SharedTagCache> SharedTags;	// 設定されている時は属性を持たないタグを共有する
+};
+
+class ScenarioData {
+	/** 構築した内容、ScenarioDictionary/ScenarioBinary が書き込み Bind で参照する */
+	struct Storage {
+		std::vector<ttstr>			Strings;
+		std::vector<tjs_uint8>		Octets;
+		std::vector<MemberRecord>	Members;
+		std::vector<tjs_uint32>		Commands;
+		std::vector<TagRecord>		Tags;
+		std::vector<ElementRecord>	Elements;
+		std::vector<LineRecord>		Lines;
+		std::vector<PageRecord>		Pages;
+		std::vector<LabelRecord>	Labels;
+		std::vector<SelectRecord>	Selects;
+		std::vector<tjs_uint32>		Choices;
+		std::vector<TextRecord>		Texts;
+		std::vector<RubyRecord>		Rubies;
+		std::vector<LineState>		States;
+		std::vector<CheckpointRecord>	Checkpoints;
+		std::vector<DiagnosticRecord>	Diagnostics;
+		std::vector<LabelRecord>	DuplicateLabels;	// 名前が重複して索引に追加しなかったラベル、行ごとの状態を記録する時のみ
+	} Owned;
+
+	// 参照する表、Owned かマップしたイメージを指す
+	RecordTable<tjs_uint8>		Octets;
+	RecordTable<MemberRecord>	Members;
+	RecordTable<tjs_uint32>		Commands;
+	RecordTable<TagRecord>		Tags;
+	RecordTable<ElementRecord>	Elements;
+	RecordTable<LineRecord>		Lines;
+	RecordTable<PageRecord>		Pages;
+	RecordTable<LabelRecord>	Labels;
+	RecordTable<SelectRecord>	Selects;
+	RecordTable<tjs_uint32>		Choices;	// 選択肢のタグ番号
+	RecordTable<TextRecord>		Texts;		// テキストのある行のみ、行順
+	RecordTable<RubyRecord>		Rubies;
+	RecordTable<LineState>		States;		// 記録した時は行数 + 1 (最後は全行解析後の状態)
+	RecordTable<CheckpointRecord>	Checkpoints;	// 行順
+	RecordTable<DiagnosticRecord>	Diagnostics;	// 出力順
+
+	// イメージの時の文字列表と文字領域、文字列は参照された時に生成する
+	std::shared_ptr<const void> Image;
+	RecordTable<StringEntry>	StringEntries;
+	const tjs_char*				StringChars = nullptr;
+	mutable std::vector<ttstr>	StringCache;
+	mutable std::vector<bool>	StringCreated;
+
+	// 文字列テーブルを詰めて作った時の文字列数。前回の表を引き継いだ時は引き継ぎ元の値
+	tjs_uint32 BaseStringCount = 0;
+
+	/** 構築した内容を参照する */
+	void Bind();
+
+	/** 構造のハッシュに値/タグを加える。文字列は番号ではなく内容を加える */
+	void HashString( Hash128& h, tjs_uint32 index ) const;
+	void HashValue( Hash128& h, const ValueRecord& value ) const;
+	void HashTag( Hash128& h, tjs_uint32 index ) const;
+
+	friend class ScenarioDictionary;
+	friend class ScenarioBinary;
+	friend class ScenarioImage;
+	friend class ScenarioJson;
+
+public:
+	static const tjs_uint32 NoString = 0xffffffff;
+	static const tjs_uint32 NoTag = 0xffffffff;
+
+	tjs_int GetLineCount() const { return static_cast<tjs_int>( Lines.size() ); }
+	const LineRecord& GetLine( tjs_int line ) const { return Lines[line]; }
+	tjs_int GetPageCount() const { return static_cast<tjs_int>( Pages.size() ); }
+	const PageRecord& GetPage( tjs_int page ) const { return Pages[page]; }
+	tjs_int GetLabelCount() const { return static_cast<tjs_int>( Labels.size() ); }
+	const LabelRecord& GetLabel( tjs_int label ) const { return Labels[label]; }
+	tjs_int GetSelectCount() const { return static_cast<tjs_int>( Selects.size() ); }
+	const SelectRecord& GetSelect( tjs_int select ) const { return Selects[select]; }
+	tjs_uint32 GetChoice( tjs_uint32 index ) const { return Choices[index]; }
+	tjs_int GetTextCount() const { return static_cast<tjs_int>( Texts.size() ); }
+	const TextRecord& GetText( tjs_int text ) const { return Texts[text]; }
+	const RubyRecord& GetRuby( tjs_uint32 index ) const { return Rubies[index]; }
+	/** 行ごとの解析状態を記録しているか */
+	bool HasLineStates() const { return !States.empty(); }
+	const LineState& GetLineState( tjs_int line ) const { return States[line]; }
+	tjs_int GetCheckpointCount() const { return static_cast<tjs_int>( Checkpoints.size() ); }
+	const CheckpointRecord& GetCheckpoint( tjs_int index ) const { return Checkpoints[index]; }
+	tjs_int GetDiagnosticCount() const { return static_cast<tjs_int>( Diagnostics.size() ); }
+	const DiagnosticRecord& GetDiagnostic( tjs_int index ) const { return Diagnostics[index]; }
+	const TagRecord& GetTag( tjs_uint32 index ) const { return Tags[index]; }
+	const ElementRecord& GetElement( tjs_uint32 index ) const { return Elements[index]; }
+	const MemberRecord& GetMember( tjs_uint32 index ) const { return Members[index]; }
+	tjs_uint32 GetCommand( tjs_uint32 index ) const { return Commands[index]; }
+	tjs_uint32 GetStringCount() const { return Image ? StringEntries.size() : static_cast<tjs_uint32>( Owned.Strings.size() ); }
+	const ttstr& GetString( tjs_uint32 index ) const {
+		if( !Image ) return Owned.Strings[index];
+		if( !StringCreated[index] ) {
+			const StringEntry& entry = StringEntries[index];
+			StringCache[index] = ttstr( StringChars + entry.Offset, static_cast<tjs_int>( entry.Length ) );
+			StringCreated[index] = true;
+		}
+		return StringCache[index];
+	}
+	/** 使用しているメモリの概算(バイト)、イメージの時はマップした領域も含む */
+	size_t GetMemorySize() const;
+	/** マップしたイメージを参照しているか */
+	bool IsImage() const { return Image != nullptr; }
+
+	/** 診断のログの文字列を作る。line は 0 から */
+	static ttstr FormatDiagnostic( DiagnosticType type, tjs_int line, const ttstr& message );
+	/** 記録した診断をそのままログに出力する */
+	void LogDiagnostics() const;
+	/**
+	 * 解析結果の構造のハッシュ。行/タグ/ページ/ラベル/選択肢/表示テキスト/チェックポイントの内容から求め、
+	 * 文字列表やタグの並び順によらない。行ごとの解析状態と診断は含めない
+	 */
+	Hash128Value GetStructureHash() const;
+
+	/** 値を生成する */
+	tTJSVariant CreateValue( const ValueRecord& value ) const;
+	/** タグの辞書を生成する */
+	iTJSDispatch2* CreateTag( tjs_uint32 index, const ScenarioOption& option ) const;
+	/** 1行分の値を生成する */
+	tTJSVariant CreateLine( tjs_int line, const ScenarioOption& option ) const;
+
+	/** lines の各要素がどの行に対応するかを求める */
+	void CreateEntries( const ScenarioOption& option, std::vector<LineEntry>& entries ) const;
+	/** 元の行番号から lines の位置を求める。compactLines でない時は行番号そのまま */
+	static tjs_int FindEntry( const std::vector<LineEntry>& entries, tjs_int line, const ScenarioOption& option );
+	/**
+	 * 元の行の範囲 first から last にかかる lines の範囲を求める。該当する要素がない時は end < begin
+	 * compactLines 指定時は、範囲に隣接する空行の要素も含める
+	 */
+	static void FindEntryRange( const std::vector<LineEntry>& entries, tjs_int first, tjs_int last, const ScenarioOption& option, tjs_int& begin, tjs_int& end );
+	/** lines の1要素を生成する */
+	tTJSVariant CreateEntry( const LineEntry& entry, const ScenarioOption& option ) const;
+
+	/** 全行の配列を生成する */
+	iTJSDispatch2* CreateLines( const std::vector<LineEntry>& entries, const ScenarioOption& option ) const;
+	/** ページの開始/終了位置の配列を生成する */
+	iTJSDispatch2* CreatePages( const std::vector<LineEntry>& entries, const ScenarioOption& option ) const;
+	/** ラベル名からラベルの位置と説明を引く辞書を生成する */
+	iTJSDispatch2* CreateLabels( const std::vector<LineEntry>& entries, const ScenarioOption& option ) const;
+	/** 選択肢のまとまりごとの辞書の配列を生成する */
+	iTJSDispatch2* CreateSelects( const std::vector<LineEntry>& entries, const ScenarioOption& option ) const;
+	/** lines と同じ並びの表示テキストの配列と読みの配列を生成する */
+	void CreateTexts( const std::vector<LineEntry>& entries, const ScenarioOption& option, iTJSDispatch2*& texts, iTJSDispatch2*& readings ) const;
+
+	/** チェックポイントの辞書の配列を生成する */
+	iTJSDispatch2* CreateCheckpoints() const;
+
+	/**
+	 * 解析結果の辞書を生成する
+	 * 遅延生成時は lines に行を参照された時に生成する配列風のオブジェクトが入る
+	 */
+	static iTJSDispatch2* CreateScenario( const std::shared_ptr<const ScenarioData>& data, const ScenarioOption& option );
+};
+
+#endif // __SCENARIO_DATA_H__
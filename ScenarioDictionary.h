@@ -1,5 +1,6 @@
 /**
- * シナリオスクリプトを構造化した辞書を管理する
+ * シナリオスクリプトを構造化したデータを構築する
+ * 解析結果は ScenarioData に固定長レコードとして格納し、辞書は生成しない
  */
 
 #ifndef __SCENARIO_DICTIONARY_H__
@@ -10,96 +11,746 @@
 #endif
 #include "tp_stub.h"
 #include "Tag.h"
+#include "ScenarioData.h"
+#include "StringPool.h"
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <string.h>
 
 class ScenarioDictionary {
 	tjs_int CurrentLine = 0;
-	iTJSDispatch2* Lines = nullptr;
-	iTJSDispatch2* CurrentLineArray = nullptr;
-	tjs_int LineIndex = 0;
+	std::shared_ptr<ScenarioData> Data;
+	StringPool& Pool;
+	// プールされた文字列 -> 文字列番号
+	std::unordered_map<const tTJSVariantString*, tjs_uint32> StringIndex;
+	// 登録されたタグ名(プールされた文字列) -> タグ番号
+	const std::unordered_map<const tTJSVariantString*, tjs_int32>* TagIds = nullptr;
+	// 現在の行に追加するテキスト、連続するテキストはここで連結し1つの要素とする
+	tjs_string PendingText;
+	bool HasPendingText = false;
+	// 登録済みのラベル名(プールされた文字列)
+	std::unordered_set<const tTJSVariantString*> LabelNames;
+	// 行ごとの表示テキストを作るか
+	bool PlainText = false;
+	// 重複したラベルを記録するか
+	bool RecordDuplicates = false;
+	// 現在の行の表示テキストと、その行のルビの開始位置
+	tjs_string LineText;
+	tjs_uint32 LineRubyBegin = 0;
+	// ルビか文字装飾になる空のタグの番号と、その時点の表示テキストの長さ
+	std::vector<std::pair<tjs_uint32, tjs_uint32> > RubyMarks;
+	// 選択肢のまとまりが続いているか
+	bool HasOpenSelect = false;
+	// 現在のページの開始行と最後に要素があった行、ページ外の時は PageBegin が -1
+	tjs_int PageBegin = -1;
+	tjs_int PageEnd = -1;
+	// 文字列テーブルを引き継いだ内部表現、この表現の文字列は番号をそのまま使う
+	const ScenarioData* SharedStrings = nullptr;
 
-public:
-	ScenarioDictionary() {
-		Lines = TJSCreateArrayObject();
+	/** まとめて写すレコードの範囲 */
+	struct Span {
+		tjs_uint32 Begin = 0xffffffff;
+		tjs_uint32 End = 0;
+		void add( tjs_uint32 index, tjs_uint32 count ) {
+			if( !count ) return;
+			if( index < Begin ) Begin = index;
+			if( index + count > End ) End = index + count;
+		}
+	};
+	/** 表の範囲を末尾に追加し、元の番号に加えると追加先の番号になる差分を返す */
+	template<typename T>
+	static tjs_uint32 appendSpan( std::vector<T>& out, const RecordTable<T>& src, const Span& span ) {
+		const tjs_uint32 base = static_cast<tjs_uint32>( out.size() );
+		if( span.Begin >= span.End ) return 0;
+		out.insert( out.end(), src.data() + span.Begin, src.data() + span.End );
+		return base - span.Begin;
+	}
+	/** 行順に並んだ表から、line 行以降の最初の要素の位置を二分探索で求める */
+	template<typename T>
+	static tjs_uint32 lowerLine( const RecordTable<T>& table, tjs_uint32 line ) {
+		tjs_uint32 lo = 0, hi = table.size();
+		while( lo < hi ) {
+			tjs_uint32 mid = ( lo + hi ) / 2;
+			if( table[mid].Line < line ) lo = mid + 1;
+			else hi = mid;
+		}
+		return lo;
+	}
+
+	/** 現在の行のレコードを取得する */
+	LineRecord& currentLine() {
+		if( static_cast<tjs_uint>( CurrentLine ) >= Data->Owned.Lines.size() ) {
+			Data->Owned.Lines.resize( CurrentLine + 1, LineRecord{ static_cast<tjs_uint32>( LineType::Void ), 0, 0 } );
+		}
+		return Data->Owned.Lines[CurrentLine];
+	}
+	/** 連結中のテキストを現在の行配列に追加する */
+	void flushText() {
+		if( HasPendingText ) {
+			HasPendingText = false;
+			tjs_uint32 index = addString( ttstr( PendingText.c_str(), static_cast<tjs_int>( PendingText.size() ) ) );
+			PendingText.clear();
+			addElement( ElementType::Text, index );
+		}
+	}
+	/** 現在のページを閉じる */
+	void closePage() {
+		if( PageBegin >= 0 ) {
+			Data->Owned.Pages.push_back( PageRecord{ static_cast<tjs_uint32>( PageBegin ), static_cast<tjs_uint32>( PageEnd ) } );
+			PageBegin = -1;
+		}
+	}
+	/** 現在の行の表示テキストを確定する */
+	void flushLineText() {
+		tjs_uint32 rubyCount = static_cast<tjs_uint32>( Data->Owned.Rubies.size() ) - LineRubyBegin;
+		if( !LineText.empty() || rubyCount ) {
+			tjs_uint32 text = addString( ttstr( LineText.c_str(), static_cast<tjs_int>( LineText.size() ) ) );
+			Data->Owned.Texts.push_back( TextRecord{ static_cast<tjs_uint32>( CurrentLine ), text, LineRubyBegin, rubyCount } );
+			LineText.clear();
+		}
+		LineRubyBegin = static_cast<tjs_uint32>( Data->Owned.Rubies.size() );
+		RubyMarks.clear();
+	}
+	/** 現在の行の型を設定する */
+	void setLine( LineType type, tjs_uint32 index = 0 ) {
+		flushText();
+		if( type == LineType::Empty ) {
+			closePage();
+		} else if( type == LineType::Tag && PageBegin >= 0 ) {
+			PageEnd = CurrentLine;
+		}
+		LineRecord& line = currentLine();
+		line.Type = static_cast<tjs_uint32>( type );
+		line.Index = index;
+		line.Count = 0;
+	}
+	/** 現在の行配列に要素を追加する */
+	void addElement( ElementType type, tjs_uint32 index ) {
+		if( type != ElementType::Text ) flushText();
+		LineRecord& line = currentLine();
+		if( line.Type != static_cast<tjs_uint32>( LineType::Elements ) ) {
+			line.Type = static_cast<tjs_uint32>( LineType::Elements );
+			line.Index = static_cast<tjs_uint32>( Data->Owned.Elements.size() );
+			line.Count = 0;
+		}
+		Data->Owned.Elements.push_back( ElementRecord{ static_cast<tjs_uint32>( type ), index } );
+		line.Count++;
+		if( type == ElementType::Text && PageBegin < 0 ) PageBegin = CurrentLine;
+		if( PageBegin >= 0 ) PageEnd = CurrentLine;
+	}
+	/** タグのレコードを確保する */
+	tjs_uint32 reserveTag() {
+		tjs_uint32 index = static_cast<tjs_uint32>( Data->Owned.Tags.size() );
+		Data->Owned.Tags.push_back( TagRecord{ ScenarioData::NoString, -1, 0, 0, 0, 0, 0, 0, 0, { 0, 0, 0 } } );
+		return index;
+	}
+	/** 他の内部表現の文字列をこのシナリオの文字列テーブルに追加し、その番号を返す */
+	tjs_uint32 copyString( const ScenarioData& src, tjs_uint32 index ) {
+		return &src == SharedStrings ? index : addString( src.GetString( index ) );
+	}
+	/** 他の内部表現の値をこのシナリオの値に変換する */
+	ValueRecord copyValue( const ScenarioData& src, const ValueRecord& value ) {
+		ValueRecord rec = value;
+		switch( static_cast<ValueType>( value.Type ) ) {
+		case ValueType::String:
+		case ValueType::Reference:
+			rec.Index = copyString( src, value.Index );
+			break;
+		case ValueType::FileProperty:
+			rec.Index = copyString( src, value.Index );
+			rec.Data = copyString( src, static_cast<tjs_uint32>( value.Data ) );
+			break;
+		case ValueType::Octet: {
+			rec.Index = static_cast<tjs_uint32>( Data->Owned.Octets.size() );
+			const tjs_uint8* data = src.Octets.data() + value.Index;
+			Data->Owned.Octets.insert( Data->Owned.Octets.end(), data, data + value.Data );
+			break;
+		}
+		default:
+			break;
+		}
+		return rec;
+	}
+	/** 他の内部表現のタグをこのシナリオに追加し、タグ番号を返す */
+	tjs_uint32 copyTag( const ScenarioData& src, tjs_uint32 index ) {
+		const TagRecord& tag = src.GetTag( index );
+		tjs_uint32 result = reserveTag();
+		TagRecord rec = tag;
+		if( tag.Name != ScenarioData::NoString ) rec.Name = copyString( src, tag.Name );
+		rec.MemberBegin = static_cast<tjs_uint32>( Data->Owned.Members.size() );
+		for( tjs_uint32 i = 0; i < tag.MemberCount; i++ ) {
+			const MemberRecord& member = src.GetMember( tag.MemberBegin + i );
+			MemberRecord m;
+			m.Target = member.Target;
+			m.Name = copyString( src, member.Name );
+			m.Value = copyValue( src, member.Value );
+			Data->Owned.Members.push_back( m );
+		}
+		rec.CommandBegin = static_cast<tjs_uint32>( Data->Owned.Commands.size() );
+		for( tjs_uint32 i = 0; i < tag.CommandCount; i++ ) {
+			Data->Owned.Commands.push_back( copyString( src, src.GetCommand( tag.CommandBegin + i ) ) );
+		}
+		Data->Owned.Tags[result] = rec;
+		return result;
+	}
+	/** 他の内部表現のラベルの行から、索引に追加するラベル名と説明を取り出す */
+	static bool findLabel( const ScenarioData& src, const TagRecord& tag, ttstr& name, ttstr& description ) {
+		for( tjs_uint32 i = 0; i < tag.MemberCount; i++ ) {
+			const MemberRecord& member = src.GetMember( tag.MemberBegin + i );
+			if( member.Target != static_cast<tjs_uint32>( MemberTarget::Field ) || member.Value.Type != static_cast<tjs_uint32>( ValueType::String ) ) continue;
+			const ttstr& field = src.GetString( member.Name );
+			if( field == ttstr( GetRWord()->name() ) ) {
+				name = src.GetString( member.Value.Index );
+			} else if( field == ttstr( GetRWord()->description() ) ) {
+				description = src.GetString( member.Value.Index );
+			}
+		}
+		return !name.IsEmpty();
+	}
+	/** 他の内部表現の警告/エラーを line 行のものとして記録し、ログに出力する */
+	void copyDiagnostic( const ScenarioData& src, const DiagnosticRecord& diagnostic, tjs_int line ) {
+		DiagnosticRecord rec = diagnostic;
+		rec.Line = static_cast<tjs_uint32>( line );
+		rec.Message = copyString( src, diagnostic.Message );
+		if( diagnostic.Line == rec.Line ) {
+			rec.Text = copyString( src, diagnostic.Text );
+		} else {
+			rec.Text = addString( ScenarioData::FormatDiagnostic( static_cast<DiagnosticType>( diagnostic.Type ), line, src.GetString( diagnostic.Message ) ) );
+		}
+		Data->Owned.Diagnostics.push_back( rec );
+		TVPAddLog( Data->Owned.Strings[rec.Text] );
 	}
+	/** タグをこのシナリオに結び付け、タグ番号を返す */
+	tjs_uint32 bindTag( Tag& tag ) {
+		if( tag.owner_ != this ) {
+			tag.owner_ = this;
+			tag.index_ = reserveTag();
+		}
+		return tag.index_;
+	}
+
+public:
+	ScenarioDictionary( StringPool& pool, const std::unordered_map<const tTJSVariantString*, tjs_int32>* tagIds = nullptr )
+		: Data( new ScenarioData() ), Pool( pool ), TagIds( tagIds ) {}
 	~ScenarioDictionary() {
 		release();
 	}
 	void release() {
-		if( CurrentLineArray ) {
-			CurrentLineArray->Release();
-			CurrentLineArray = nullptr;
+		PendingText.clear();
+		HasPendingText = false;
+		PageBegin = -1;
+		PageEnd = -1;
+		LabelNames.clear();
+		HasOpenSelect = false;
+		LineText.clear();
+		LineRubyBegin = 0;
+		RubyMarks.clear();
+		Data.reset();
+		StringIndex.clear();
+		SharedStrings = nullptr;
+		CurrentLine = 0;
+	}
+	/** シナリオの行を確保する */
+	void createLines( tjs_int count ) {
+		if( !Data ) {
+			Data.reset( new ScenarioData() );
 		}
-		if( Lines ) {
-			Lines->Release();
-			Lines = nullptr;
+		Data->Owned.Lines.assign( count, LineRecord{ static_cast<tjs_uint32>( LineType::Void ), 0, 0 } );
+	}
+	/** 文字列テーブルに文字列を追加し、その番号を返す */
+	tjs_uint32 addString( const ttstr& str ) {
+		return addPooledString( Pool.Intern( str ) );
+	}
+	/** プール済みの文字列を文字列テーブルに追加し、その番号を返す */
+	tjs_uint32 addPooledString( const ttstr& pooled ) {
+		const tTJSVariantString* key = pooled.AsVariantStringNoAddRef();
+		auto found = StringIndex.find( key );
+		if( found != StringIndex.end() ) {
+			return found->second;
 		}
-		CurrentLine = 0;
-		LineIndex = 0;
+		tjs_uint32 index = static_cast<tjs_uint32>( Data->Owned.Strings.size() );
+		Data->Owned.Strings.push_back( pooled );
+		StringIndex.insert( std::make_pair( key, index ) );
+		return index;
 	}
-	/** シナリオの行配列を生成する */
-	void createLines() {
-		if( !Lines ) {
-			Lines = TJSCreateArrayObject();
+	/** 値をレコードに変換する */
+	ValueRecord addValue( const tTJSVariant& val ) {
+		ValueRecord rec = { static_cast<tjs_uint32>( ValueType::Void ), 0, 0 };
+		switch( val.Type() ) {
+		case tvtObject:	// 字句抽出器から来るオブジェクトは null のみ
+			rec.Type = static_cast<tjs_uint32>( ValueType::Null );
+			break;
+		case tvtString:
+			rec.Type = static_cast<tjs_uint32>( ValueType::String );
+			rec.Index = addString( ttstr( val.AsStringNoAddRef() ) );
+			break;
+		case tvtOctet: {
+			tTJSVariantOctet* oct = val.AsOctetNoAddRef();
+			rec.Type = static_cast<tjs_uint32>( ValueType::Octet );
+			rec.Index = static_cast<tjs_uint32>( Data->Owned.Octets.size() );
+			if( oct ) {
+				const tjs_uint8* data = oct->GetData();
+				Data->Owned.Octets.insert( Data->Owned.Octets.end(), data, data + oct->GetLength() );
+				rec.Data = oct->GetLength();
+			}
+			break;
+		}
+		case tvtInteger:
+			rec.Type = static_cast<tjs_uint32>( ValueType::Integer );
+			rec.Data = val.AsInteger();
+			break;
+		case tvtReal: {
+			tjs_real d = val.AsReal();
+			rec.Type = static_cast<tjs_uint32>( ValueType::Real );
+			memcpy( &rec.Data, &d, sizeof( d ) );
+			break;
 		}
+		default:
+			break;
+		}
+		return rec;
 	}
-	/** 現在の行の配列を生成する */
-	void createLineArray() {
-		if( !CurrentLineArray ) {
-			CurrentLineArray = TJSCreateArrayObject();
-			tTJSVariant val( CurrentLineArray, CurrentLineArray );
-			setValue( val );
+	/** タグの内容をレコードに書き込む */
+	void commitTag( tjs_uint32 index, const Tag& tag ) {
+		if( !Data ) return;
+		TagRecord& rec = Data->Owned.Tags[index];
+		rec.Name = ScenarioData::NoString;
+		rec.Id = -1;
+		if( tag.has_name_ ) {
+			const ttstr& name = Pool.Intern( tag.name_ );
+			rec.Name = addPooledString( name );
+			if( TagIds ) {
+				auto found = TagIds->find( name.AsVariantStringNoAddRef() );
+				if( found != TagIds->end() ) rec.Id = found->second;
+			}
+		}
+		rec.MemberBegin = static_cast<tjs_uint32>( Data->Owned.Members.size() );
+		rec.MemberCount = static_cast<tjs_uint32>( tag.members_.size() );
+		for( const auto& member : tag.members_ ) {
+			MemberRecord m;
+			m.Target = static_cast<tjs_uint32>( member.target );
+			m.Name = addString( member.name );
+			switch( member.kind ) {
+			case Tag::ValueKind::Reference:
+				m.Value.Type = static_cast<tjs_uint32>( ValueType::Reference );
+				m.Value.Index = addString( ttstr( member.value.AsStringNoAddRef() ) );
+				m.Value.Data = 0;
+				break;
+			case Tag::ValueKind::FileProperty:
+				m.Value.Type = static_cast<tjs_uint32>( ValueType::FileProperty );
+				m.Value.Index = addString( ttstr( member.value.AsStringNoAddRef() ) );
+				m.Value.Data = addString( member.prop );
+				break;
+			default:
+				m.Value = addValue( member.value );
+				break;
+			}
+			Data->Owned.Members.push_back( m );
+		}
+		rec.CommandBegin = static_cast<tjs_uint32>( Data->Owned.Commands.size() );
+		rec.CommandCount = static_cast<tjs_uint32>( tag.commands_.size() );
+		for( const auto& command : tag.commands_ ) {
+			Data->Owned.Commands.push_back( addString( command ) );
+		}
+		rec.Signs = tag.signs_;
+		rec.SignCount = tag.sign_count_;
+		rec.TimingMask = tag.timing_mask_;
+		for( int i = 0; i < static_cast<int>( TimingType::Count ); i++ ) {
+			rec.Timings[i] = ( tag.timing_mask_ & ( 1U << i ) ) ? tag.timings_[i] : 0;
 		}
 	}
-	/** 現在の行に値を設定する */
-	void setValue( const tTJSVariant& val ) {
-		createLines();
-		Lines->PropSetByNum( TJS_MEMBERENSURE, CurrentLine, &val, Lines );
+
+	/** 現在の行に空行を設定する */
+	void setEmpty() {
+		setLine( LineType::Empty );
 	}
-	/** 現在の行に整数を設定する */
-	void setValue( tjs_int i ) {
-		tTJSVariant tmp( i );
-		setValue( tmp );
+	/**
+	 * 現在の行のラベルを索引に追加する
+	 * 同じ名前のラベルが既にある時は先のものを優先し、false を返す
+	 */
+	bool addLabel( const ttstr& name, const ttstr& description ) {
+		const ttstr& pooled = Pool.Intern( name );
+		if( !LabelNames.insert( pooled.AsVariantStringNoAddRef() ).second ) {
+			if( RecordDuplicates ) Data->Owned.DuplicateLabels.push_back( LabelRecord{ addPooledString( pooled ), ScenarioData::NoString, static_cast<tjs_uint32>( CurrentLine ) } );
+			return false;
+		}
+		LabelRecord rec;
+		rec.Name = addPooledString( pooled );
+		rec.Description = description.IsEmpty() ? ScenarioData::NoString : addString( description );
+		rec.Line = static_cast<tjs_uint32>( CurrentLine );
+		Data->Owned.Labels.push_back( rec );
+		return true;
+	}
+	/**
+	 * 現在の行に設定した選択肢のタグを選択肢のまとまりに追加する
+	 * 続いている選択肢のまとまりがない時は、新しいまとまりを始める
+	 */
+	void addSelectChoice() {
+		const LineRecord& line = currentLine();
+		if( line.Type != static_cast<tjs_uint32>( LineType::Tag ) ) return;
+		if( !HasOpenSelect ) {
+			HasOpenSelect = true;
+			tjs_uint32 begin = static_cast<tjs_uint32>( Data->Owned.Choices.size() );
+			Data->Owned.Selects.push_back( SelectRecord{ static_cast<tjs_uint32>( CurrentLine ), 0, begin, 0, ScenarioData::NoTag } );
+		}
+		SelectRecord& select = Data->Owned.Selects.back();
+		Data->Owned.Choices.push_back( line.Index );
+		select.ChoiceCount++;
+		select.End = static_cast<tjs_uint32>( CurrentLine );
+	}
+	/** 現在の行に設定した選択肢オプションのタグで選択肢のまとまりを閉じる */
+	void closeSelect() {
+		if( !HasOpenSelect ) return;
+		HasOpenSelect = false;
+		const LineRecord& line = currentLine();
+		if( line.Type != static_cast<tjs_uint32>( LineType::Tag ) ) return;
+		SelectRecord& select = Data->Owned.Selects.back();
+		select.Option = line.Index;
+		select.End = static_cast<tjs_uint32>( CurrentLine );
 	}
 	/** 現在の行にvoidを設定する */
 	void setVoid() {
-		tTJSVariant tmp;
-		setValue( tmp );
+		setLine( LineType::Void );
 	}
 	/** 現在の行にタグを設定する */
 	void setTag( Tag& tag ) {
-		iTJSDispatch2* dic = tag.getTag();
-		if( dic ) {
-			tTJSVariant tmp( dic, dic );
-			setValue( tmp );
+		if( tag.isCreated() ) {
+			setLine( LineType::Tag, bindTag( tag ) );
 		}
 	}
-	/** 現在の行配列に値を追加する */
-	void addValueToCurrentLine( const tTJSVariant& val ) {
-		createLineArray();
-		CurrentLineArray->PropSetByNum( TJS_MEMBERENSURE, LineIndex, &val, CurrentLineArray );
-		LineIndex++;
+	/** 現在の行配列にテキストを追加する。直前の要素もテキストの時は連結する */
+	void addTextToCurrentLine( const ttstr& text ) {
+		PendingText.append( text.c_str(), text.GetLen() );
+		HasPendingText = true;
+		if( PlainText ) LineText.append( text.c_str(), text.GetLen() );
 	}
 	/** 現在の行配列にタグを追加する */
 	void addTagToCurrentLine( Tag& tag ) {
-		iTJSDispatch2* dic = tag.getTag();
-		if( dic ) {
-			tTJSVariant tmp( dic, dic );
-			addValueToCurrentLine( tmp );
+		if( tag.isCreated() ) {
+			addElement( ElementType::Tag, bindTag( tag ) );
 		}
 	}
+	/** 現在の行配列に空のタグを追加し、そのタグ番号を返す。後から Tag::bind で結び付けて埋める */
+	tjs_uint32 addEmptyTagToCurrentLine() {
+		tjs_uint32 index = reserveTag();
+		addElement( ElementType::Tag, index );
+		if( PlainText ) RubyMarks.push_back( std::make_pair( index, static_cast<tjs_uint32>( LineText.size() ) ) );
+		return index;
+	}
+	/**
+	 * addEmptyTagToCurrentLine で追加したタグがルビになった時に、親文字の範囲と読みを記録する
+	 * 親文字はタグを追加してから現在までに追加されたテキスト
+	 * @param reading 読み、辞書から引くルビの時は nullptr
+	 */
+	void addRuby( tjs_uint32 index, const ttstr* reading ) {
+		if( !PlainText ) return;
+		for( auto it = RubyMarks.rbegin(); it != RubyMarks.rend(); ++it ) {
+			if( it->first == index ) {
+				RubyRecord rec;
+				rec.Begin = it->second;
+				rec.Length = static_cast<tjs_uint32>( LineText.size() ) - it->second;
+				rec.Reading = reading ? addString( *reading ) : ScenarioData::NoString;
+				Data->Owned.Rubies.push_back( rec );
+				return;
+			}
+		}
+	}
+	/**
+	 * 他の内部表現の1行を現在の行に写す
+	 * 解析した時と同じ順で行や要素を追加し、ページ/ラベル/選択肢の索引と表示テキストも解析時と同様に作る
+	 */
+	void copyLine( const ScenarioData& src, tjs_int line ) {
+		const LineRecord& rec = src.GetLine( line );
+		switch( static_cast<LineType>( rec.Type ) ) {
+		case LineType::Empty:
+			setEmpty();
+			break;
+		case LineType::Tag: {
+			setLine( LineType::Tag, copyTag( src, rec.Index ) );
+			const TagRecord& tag = src.GetTag( rec.Index );
+			if( tag.Name == ScenarioData::NoString ) break;
+			const ttstr& name = src.GetString( tag.Name );
+			if( name == ttstr( GetRWord()->label() ) ) {
+				ttstr label, description;
+				if( findLabel( src, tag, label, description ) ) addLabel( label, description );
+			} else if( name == ttstr( GetRWord()->select() ) ) {
+				addSelectChoice();
+			} else if( name == ttstr( GetRWord()->selopt() ) ) {
+				closeSelect();
+			}
+			break;
+		}
+		case LineType::Elements:
+			for( tjs_uint32 i = 0; i < rec.Count; i++ ) {
+				const ElementRecord& element = src.GetElement( rec.Index + i );
+				if( element.Type == static_cast<tjs_uint32>( ElementType::Text ) ) {
+					addElement( ElementType::Text, copyString( src, element.Index ) );
+				} else {
+					addElement( ElementType::Tag, copyTag( src, element.Index ) );
+				}
+			}
+			break;
+		default:
+			setVoid();
+			break;
+		}
+		if( PlainText ) {
+			// 表示テキストは行順に並んでいるので二分探索する
+			tjs_uint32 lo = lowerLine( src.Texts, static_cast<tjs_uint32>( line ) );
+			if( lo < src.Texts.size() && src.Texts[lo].Line == static_cast<tjs_uint32>( line ) ) {
+				const TextRecord& text = src.Texts[lo];
+				const ttstr& str = src.GetString( text.Text );
+				LineText.assign( str.c_str(), str.GetLen() );
+				for( tjs_uint32 i = 0; i < text.RubyCount; i++ ) {
+					RubyRecord ruby = src.GetRuby( text.RubyBegin + i );
+					if( ruby.Reading != ScenarioData::NoString ) ruby.Reading = copyString( src, ruby.Reading );
+					Data->Owned.Rubies.push_back( ruby );
+				}
+			}
+		}
+	}
+	/** 行の開始時点の解析状態を記録する。行順に呼び、最後に全行解析後の状態を記録すること */
+	void addLineState( tjs_uint64 hash, tjs_uint32 flags, const ttstr& fixTagName ) {
+		tjs_uint32 name = fixTagName.IsEmpty() ? ScenarioData::NoString : addString( fixTagName );
+		Data->Owned.States.push_back( LineState{ hash, flags, name } );
+	}
+	/** 文字列テーブルを引き継いだ内部表現の解析状態をそのまま記録する */
+	void addLineState( const LineState& state ) {
+		Data->Owned.States.push_back( state );
+	}
+	/** 現在の行の開始時点の解析状態をチェックポイントとして記録する */
+	void addCheckpoint( tjs_uint32 flags, const ttstr& fixTagName ) {
+		tjs_uint32 name = fixTagName.IsEmpty() ? ScenarioData::NoString : addString( fixTagName );
+		addCheckpoint( CurrentLine, flags, name );
+	}
+	/** line 行の開始時点の解析状態をチェックポイントとして記録する。fixTagName は文字列番号 */
+	void addCheckpoint( tjs_int line, tjs_uint32 flags, tjs_uint32 fixTagName ) {
+		Data->Owned.Checkpoints.push_back( CheckpointRecord{ static_cast<tjs_uint32>( line ), flags, fixTagName } );
+	}
+	/** 文字列テーブルを引き継いだ内部表現の end 行より前のチェックポイントを写し、最後のチェックポイントの行を返す。ない時は -1 */
+	tjs_int copyCheckpoints( const ScenarioData& src, tjs_int end ) {
+		tjs_uint32 count = lowerLine( src.Checkpoints, static_cast<tjs_uint32>( end ) );
+		Data->Owned.Checkpoints.insert( Data->Owned.Checkpoints.end(), src.Checkpoints.data(), src.Checkpoints.data() + count );
+		return count ? static_cast<tjs_int>( src.Checkpoints[count - 1].Line ) : -1;
+	}
+	/** 出力した警告/エラーを記録する。text は種類と行番号を付けたログ */
+	void addDiagnostic( DiagnosticType type, tjs_int line, const ttstr& message, const ttstr& text ) {
+		if( !Data ) return;
+		Data->Owned.Diagnostics.push_back( DiagnosticRecord{ static_cast<tjs_uint32>( type ), static_cast<tjs_uint32>( line ), addString( message ), addString( text ) } );
+	}
+	/**
+	 * 前回の内部表現の line 行で出力した警告/エラーを現在の行のものとして記録し、ログに出力する
+	 * 引き継いだ行も解析し直した時と同じログになるようにする
+	 */
+	void copyDiagnostics( const ScenarioData& src, tjs_int line ) {
+		// 診断は行順に並んでいるので二分探索する
+		tjs_uint32 lo = lowerLine( src.Diagnostics, static_cast<tjs_uint32>( line ) );
+		for( ; lo < src.Diagnostics.size() && src.Diagnostics[lo].Line == static_cast<tjs_uint32>( line ); lo++ ) {
+			copyDiagnostic( src, src.Diagnostics[lo], CurrentLine );
+		}
+	}
+	/**
+	 * 他の内部表現の文字列テーブルを引き継ぐ。文字列を追加する前に呼ぶこと
+	 * 引き継ぎを繰り返して使われない文字列が増えている時は引き継がず、false を返す。
+	 */
+	bool shareStrings( const ScenarioData& src ) {
+		if( src.IsImage() || !Data->Owned.Strings.empty() ) return false;
+		const tjs_uint32 base = src.BaseStringCount;
+		if( src.GetStringCount() > base + base / 2 + 256 ) return false;
+		Data->Owned.Strings = src.Owned.Strings;
+		Data->BaseStringCount = base;
+		SharedStrings = &src;
+		return true;
+	}
+	/** ページや選択肢のまとまりの途中かを LineStateFlag のビットで返す。連結中のテキストは先に行に追加する */
+	tjs_uint32 getOpenFlags() {
+		flushText();
+		tjs_uint32 flags = 0;
+		if( PageBegin >= 0 ) flags |= static_cast<tjs_uint32>( LineStateFlag::OpenPage );
+		if( HasOpenSelect ) flags |= static_cast<tjs_uint32>( LineStateFlag::OpenSelect );
+		return flags;
+	}
+	/** 重複したラベルを記録するかどうかを設定する */
+	void setRecordDuplicates( bool enable ) {
+		RecordDuplicates = enable;
+	}
+	/**
+	 * 他の内部表現の end 行以降のラベルを写した時に、索引に追加するかどうかが他の内部表現と変わる最初のラベルの行を返す
+	 * [begin, end) 行は内容が変わった範囲で、それより前のラベルは他の内部表現と同じであること。変わらない時は -1
+	 */
+	tjs_int findLabelConflict( const ScenarioData& src, tjs_int begin, tjs_int end ) {
+		const tjs_uint32 first = static_cast<tjs_uint32>( begin );
+		const tjs_uint32 last = static_cast<tjs_uint32>( end );
+		tjs_int conflict = -1;
+		// 索引に追加したラベルが、変わった範囲で追加したラベルと重複するようになるか
+		for( tjs_uint32 i = lowerLine( src.Labels, last ); i < src.Labels.size(); i++ ) {
+			if( LabelNames.count( Pool.Intern( src.GetString( src.Labels[i].Name ) ).AsVariantStringNoAddRef() ) ) {
+				conflict = static_cast<tjs_int>( src.Labels[i].Line );
+				break;
+			}
+		}
+		// 変わった範囲の前回のラベルと重複して追加しなかったラベルが、重複しなくなるか
+		for( const LabelRecord& duplicate : src.Owned.DuplicateLabels ) {
+			if( duplicate.Line < last ) continue;
+			if( conflict >= 0 && duplicate.Line >= static_cast<tjs_uint32>( conflict ) ) break;
+			const ttstr& name = src.GetString( duplicate.Name );
+			for( tjs_uint32 i = lowerLine( src.Labels, first ); i < src.Labels.size() && src.Labels[i].Line < last; i++ ) {
+				if( src.GetString( src.Labels[i].Name ) == name && !LabelNames.count( Pool.Intern( name ).AsVariantStringNoAddRef() ) ) {
+					return static_cast<tjs_int>( duplicate.Line );
+				}
+			}
+		}
+		return conflict;
+	}
+	/**
+	 * 文字列テーブルを引き継いだ内部表現の [begin, end) 行を、現在の行以降にまとめて写す
+	 * レコードは行順に並んでいるので、行が参照する各表の範囲をそのまま追加して番号を付け替える。
+	 * begin と end の行の開始時点は、複数行のタグ/ページ/選択肢のまとまりの途中でないこと。
+	 * @param states 行ごとの解析状態も写すか
+	 */
+	void spliceLines( const ScenarioData& src, tjs_int begin, tjs_int end, bool states ) {
+		flushText();
+		if( PlainText ) flushLineText();
+		ScenarioData::Storage& out = Data->Owned;
+		const tjs_uint32 first = static_cast<tjs_uint32>( begin );
+		const tjs_uint32 last = static_cast<tjs_uint32>( end );
+		const tjs_uint32 shift = static_cast<tjs_uint32>( CurrentLine - begin );
+
+		// 行が参照するレコードの範囲を求める
+		Span elements, tags, members, commands, octets;
+		for( tjs_uint32 i = first; i < last; i++ ) {
+			const LineRecord& line = src.Lines[i];
+			if( line.Type == static_cast<tjs_uint32>( LineType::Tag ) ) {
+				tags.add( line.Index, 1 );
+			} else if( line.Type == static_cast<tjs_uint32>( LineType::Elements ) ) {
+				elements.add( line.Index, line.Count );
+				for( tjs_uint32 j = 0; j < line.Count; j++ ) {
+					const ElementRecord& element = src.Elements[line.Index + j];
+					if( element.Type == static_cast<tjs_uint32>( ElementType::Tag ) ) tags.add( element.Index, 1 );
+				}
+			}
+		}
+		for( tjs_uint32 i = tags.Begin; i < tags.End; i++ ) {
+			members.add( src.Tags[i].MemberBegin, src.Tags[i].MemberCount );
+			commands.add( src.Tags[i].CommandBegin, src.Tags[i].CommandCount );
+		}
+		for( tjs_uint32 i = members.Begin; i < members.End; i++ ) {
+			const ValueRecord& value = src.Members[i].Value;
+			if( value.Type == static_cast<tjs_uint32>( ValueType::Octet ) ) octets.add( value.Index, static_cast<tjs_uint32>( value.Data ) );
+		}
+
+		// 範囲ごと追加して番号を付け替える。文字列は同じ番号のまま使う
+		const tjs_uint32 octetShift = appendSpan( out.Octets, src.Octets, octets );
+		const tjs_uint32 memberBegin = static_cast<tjs_uint32>( out.Members.size() );
+		const tjs_uint32 memberShift = appendSpan( out.Members, src.Members, members );
+		for( tjs_uint32 i = memberBegin; i < out.Members.size(); i++ ) {
+			ValueRecord& value = out.Members[i].Value;
+			if( value.Type == static_cast<tjs_uint32>( ValueType::Octet ) ) value.Index = value.Data ? value.Index + octetShift : static_cast<tjs_uint32>( out.Octets.size() );
+		}
+		const tjs_uint32 commandShift = appendSpan( out.Commands, src.Commands, commands );
+		const tjs_uint32 tagBegin = static_cast<tjs_uint32>( out.Tags.size() );
+		const tjs_uint32 tagShift = appendSpan( out.Tags, src.Tags, tags );
+		for( tjs_uint32 i = tagBegin; i < out.Tags.size(); i++ ) {
+			TagRecord& tag = out.Tags[i];
+			tag.MemberBegin = tag.MemberCount ? tag.MemberBegin + memberShift : static_cast<tjs_uint32>( out.Members.size() );
+			tag.CommandBegin = tag.CommandCount ? tag.CommandBegin + commandShift : static_cast<tjs_uint32>( out.Commands.size() );
+		}
+		const tjs_uint32 elementBegin = static_cast<tjs_uint32>( out.Elements.size() );
+		const tjs_uint32 elementShift = appendSpan( out.Elements, src.Elements, elements );
+		for( tjs_uint32 i = elementBegin; i < out.Elements.size(); i++ ) {
+			if( out.Elements[i].Type == static_cast<tjs_uint32>( ElementType::Tag ) ) out.Elements[i].Index += tagShift;
+		}
+		if( out.Lines.size() < last + shift ) {
+			out.Lines.resize( last + shift, LineRecord{ static_cast<tjs_uint32>( LineType::Void ), 0, 0 } );
+		}
+		for( tjs_uint32 i = first; i < last; i++ ) {
+			LineRecord line = src.Lines[i];
+			if( line.Type == static_cast<tjs_uint32>( LineType::Tag ) ) line.Index += tagShift;
+			else if( line.Type == static_cast<tjs_uint32>( LineType::Elements ) ) line.Index += elementShift;
+			out.Lines[i + shift] = line;
+		}
+
+		// 索引は行の範囲で写す
+		for( tjs_uint32 i = lowerLine( src.Labels, first ); i < src.Labels.size() && src.Labels[i].Line < last; i++ ) {
+			LabelRecord label = src.Labels[i];
+			label.Line += shift;
+			out.Labels.push_back( label );
+			LabelNames.insert( Pool.Intern( src.GetString( label.Name ) ).AsVariantStringNoAddRef() );
+		}
+		if( RecordDuplicates ) {
+			for( const LabelRecord& duplicate : src.Owned.DuplicateLabels ) {
+				if( duplicate.Line >= first && duplicate.Line < last ) out.DuplicateLabels.push_back( LabelRecord{ duplicate.Name, duplicate.Description, duplicate.Line + shift } );
+			}
+		}
+		// ページは開始行の順に並んでいる
+		tjs_uint32 lo = 0, hi = src.Pages.size();
+		while( lo < hi ) {
+			tjs_uint32 mid = ( lo + hi ) / 2;
+			if( src.Pages[mid].Begin < first ) lo = mid + 1;
+			else hi = mid;
+		}
+		for( ; lo < src.Pages.size() && src.Pages[lo].Begin < last; lo++ ) {
+			out.Pages.push_back( PageRecord{ src.Pages[lo].Begin + shift, src.Pages[lo].End + shift } );
+		}
+		Span choices;
+		const tjs_uint32 selectBegin = static_cast<tjs_uint32>( out.Selects.size() );
+		for( tjs_uint32 i = lowerLine( src.Selects, first ); i < src.Selects.size() && src.Selects[i].Line < last; i++ ) {
+			out.Selects.push_back( src.Selects[i] );
+			choices.add( src.Selects[i].ChoiceBegin, src.Selects[i].ChoiceCount );
+		}
+		const tjs_uint32 choiceBegin = static_cast<tjs_uint32>( out.Choices.size() );
+		const tjs_uint32 choiceShift = appendSpan( out.Choices, src.Choices, choices );
+		for( tjs_uint32 i = choiceBegin; i < out.Choices.size(); i++ ) out.Choices[i] += tagShift;
+		for( tjs_uint32 i = selectBegin; i < out.Selects.size(); i++ ) {
+			SelectRecord& select = out.Selects[i];
+			select.Line += shift;
+			select.End += shift;
+			select.ChoiceBegin = select.ChoiceCount ? select.ChoiceBegin + choiceShift : static_cast<tjs_uint32>( out.Choices.size() );
+			if( select.Option != ScenarioData::NoTag ) select.Option += tagShift;
+		}
+		if( PlainText ) {
+			Span rubies;
+			const tjs_uint32 textBegin = static_cast<tjs_uint32>( out.Texts.size() );
+			for( tjs_uint32 i = lowerLine( src.Texts, first ); i < src.Texts.size() && src.Texts[i].Line < last; i++ ) {
+				out.Texts.push_back( src.Texts[i] );
+				rubies.add( src.Texts[i].RubyBegin, src.Texts[i].RubyCount );
+			}
+			const tjs_uint32 rubyShift = appendSpan( out.Rubies, src.Rubies, rubies );
+			for( tjs_uint32 i = textBegin; i < out.Texts.size(); i++ ) {
+				TextRecord& text = out.Texts[i];
+				text.Line += shift;
+				text.RubyBegin = text.RubyCount ? text.RubyBegin + rubyShift : static_cast<tjs_uint32>( out.Rubies.size() );
+			}
+			LineRubyBegin = static_cast<tjs_uint32>( out.Rubies.size() );
+		}
+		for( tjs_uint32 i = lowerLine( src.Diagnostics, first ); i < src.Diagnostics.size() && src.Diagnostics[i].Line < last; i++ ) {
+			copyDiagnostic( src, src.Diagnostics[i], static_cast<tjs_int>( src.Diagnostics[i].Line + shift ) );
+		}
+		if( states ) out.States.insert( out.States.end(), src.States.data() + first, src.States.data() + last );
+		CurrentLine += end - begin;
+	}
+	/** 行ごとの表示テキストを作るかどうかを設定する */
+	void setPlainText( bool enable ) {
+		PlainText = enable;
+	}
 	/** 現在の行を設定する */
 	void setCurrentLine( tjs_int line ) {
-		if( CurrentLine != line ) {
-			CurrentLine = line;
-			if( CurrentLineArray ) {
-				CurrentLineArray->Release();
-				CurrentLineArray = nullptr;
-				LineIndex = 0;
-			}
+		flushText();
+		if( PlainText ) flushLineText();
+		CurrentLine = line;
+		currentLine();
+	}
+	std::shared_ptr<ScenarioData> getData() {
+		flushText();
+		if( Data ) {
+			if( PlainText ) flushLineText();
+			closePage();
+			if( !SharedStrings ) Data->BaseStringCount = static_cast<tjs_uint32>( Data->Owned.Strings.size() );
+			Data->Bind();
 		}
+		return Data;
 	}
-	iTJSDispatch2* getArray() { return Lines; }
 };
 
-
 #endif // __SCENARIO_DICTIONARY_H__
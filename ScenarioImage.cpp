@@ -0,0 +1,136 @@
+
+#include "ScenarioImage.h"
+#include "ScenarioBinary.h"
+#include <string.h>
+#include <stdint.h>
+
+//---------------------------------------------------------------------------
+namespace {
+
+const tjs_uint8 Magic[4] = { 'M', 'D', 'K', 'I' };
+// セクションの境界
+const size_t Alignment = 8;
+
+/** セクションをイメージの末尾に追加する */
+void AppendSection( std::vector<tjs_uint8>& out, size_t base, ScenarioImage::Section& section, const void* data, size_t elementSize, size_t count ) {
+	while( ( out.size() - base ) % Alignment ) out.push_back( 0 );
+	section.Offset = out.size() - base;
+	section.Count = count;
+	if( count ) {
+		const tjs_uint8* p = static_cast<const tjs_uint8*>( data );
+		out.insert( out.end(), p, p + elementSize * count );
+	}
+}
+template<typename T>
+void AppendSection( std::vector<tjs_uint8>& out, size_t base, ScenarioImage::Section& section, const RecordTable<T>& table ) {
+	AppendSection( out, base, section, table.data(), sizeof( T ), table.size() );
+}
+
+/** セクションが範囲内で境界が揃っている時、表をその領域に向ける */
+template<typename T>
+bool BindSection( RecordTable<T>& table, const ScenarioImage::Section& section, const tjs_uint8* buffer, size_t size ) {
+	if( section.Count > 0xffffffff || section.Offset > size ) return false;
+	if( section.Count > ( size - static_cast<size_t>( section.Offset ) ) / sizeof( T ) ) return false;
+	const tjs_uint8* p = buffer + section.Offset;
+	if( reinterpret_cast<uintptr_t>( p ) % alignof( T ) ) return false;
+	table.Set( section.Count ? reinterpret_cast<const T*>( p ) : nullptr, static_cast<tjs_uint32>( section.Count ) );
+	return true;
+}
+
+} // namespace
+//---------------------------------------------------------------------------
+bool ScenarioImage::IsImage( const tjs_uint8* buffer, size_t size ) {
+	return buffer && size >= sizeof( Header ) && memcmp( buffer, Magic, sizeof( Magic ) ) == 0;
+}
+//---------------------------------------------------------------------------
+void ScenarioImage::WriteSections( const ScenarioData& data, const std::vector<StringEntry>& strings, std::vector<tjs_uint8>& out, size_t base, Section* sections ) {
+	AppendSection( out, base, sections[StringEntries], strings.empty() ? nullptr : strings.data(), sizeof( StringEntry ), strings.size() );
+	AppendSection( out, base, sections[Octets], data.Octets );
+	AppendSection( out, base, sections[Members], data.Members );
+	AppendSection( out, base, sections[Commands], data.Commands );
+	AppendSection( out, base, sections[Tags], data.Tags );
+	AppendSection( out, base, sections[Elements], data.Elements );
+	AppendSection( out, base, sections[Lines], data.Lines );
+	AppendSection( out, base, sections[Pages], data.Pages );
+	AppendSection( out, base, sections[Labels], data.Labels );
+	AppendSection( out, base, sections[Selects], data.Selects );
+	AppendSection( out, base, sections[Choices], data.Choices );
+	AppendSection( out, base, sections[Texts], data.Texts );
+	AppendSection( out, base, sections[Rubies], data.Rubies );
+	AppendSection( out, base, sections[Checkpoints], data.Checkpoints );
+	AppendSection( out, base, sections[Diagnostics], data.Diagnostics );
+}
+//---------------------------------------------------------------------------
+void ScenarioImage::Write( const ScenarioData& data, tjs_uint64 sourceHash, tjs_uint64 settingsHash, std::vector<tjs_uint8>& out ) {
+	const size_t base = out.size();
+	out.resize( base + sizeof( Header ) + sizeof( Section ) * SectionCount, 0 );
+	Section sections[SectionCount];
+
+	// 文字列表は内部表現の時点で重複がないので、そのまま文字領域に並べる
+	tjs_uint32 count = data.GetStringCount();
+	std::vector<StringEntry> entries( count );
+	std::vector<tjs_char> chars;
+	for( tjs_uint32 i = 0; i < count; i++ ) {
+		const ttstr& str = data.GetString( i );
+		entries[i].Offset = static_cast<tjs_uint32>( chars.size() );
+		entries[i].Length = static_cast<tjs_uint32>( str.GetLen() );
+		chars.insert( chars.end(), str.c_str(), str.c_str() + str.GetLen() );
+	}
+	WriteSections( data, entries, out, base, sections );
+	AppendSection( out, base, sections[Chars], chars.empty() ? nullptr : chars.data(), sizeof( tjs_char ), chars.size() );
+
+	Header header;
+	memcpy( header.Magic, Magic, sizeof( Magic ) );
+	header.Version = Version;
+	header.Layout = ScenarioBinary::GetLayout();
+	header.SectionCount = SectionCount;
+	header.SourceHash = sourceHash;
+	header.SettingsHash = settingsHash;
+	memcpy( &out[base], &header, sizeof( header ) );
+	memcpy( &out[base + sizeof( header )], sections, sizeof( sections ) );
+}
+//---------------------------------------------------------------------------
+std::shared_ptr<ScenarioData> ScenarioImage::OpenSections( const std::shared_ptr<const void>& owner, const Section* sections, const tjs_uint8* buffer, size_t size, const tjs_char* chars, size_t charCount ) {
+	std::shared_ptr<ScenarioData> data( new ScenarioData() );
+	if( !BindSection( data->StringEntries, sections[StringEntries], buffer, size ) ) return nullptr;
+	if( !BindSection( data->Octets, sections[Octets], buffer, size ) ) return nullptr;
+	if( !BindSection( data->Members, sections[Members], buffer, size ) ) return nullptr;
+	if( !BindSection( data->Commands, sections[Commands], buffer, size ) ) return nullptr;
+	if( !BindSection( data->Tags, sections[Tags], buffer, size ) ) return nullptr;
+	if( !BindSection( data->Elements, sections[Elements], buffer, size ) ) return nullptr;
+	if( !BindSection( data->Lines, sections[Lines], buffer, size ) ) return nullptr;
+	if( !BindSection( data->Pages, sections[Pages], buffer, size ) ) return nullptr;
+	if( !BindSection( data->Labels, sections[Labels], buffer, size ) ) return nullptr;
+	if( !BindSection( data->Selects, sections[Selects], buffer, size ) ) return nullptr;
+	if( !BindSection( data->Choices, sections[Choices], buffer, size ) ) return nullptr;
+	if( !BindSection( data->Texts, sections[Texts], buffer, size ) ) return nullptr;
+	if( !BindSection( data->Rubies, sections[Rubies], buffer, size ) ) return nullptr;
+	if( !BindSection( data->Checkpoints, sections[Checkpoints], buffer, size ) ) return nullptr;
+	if( !BindSection( data->Diagnostics, sections[Diagnostics], buffer, size ) ) return nullptr;
+	for( const auto& entry : data->StringEntries ) {
+		if( entry.Offset > charCount || entry.Length > charCount - entry.Offset ) return nullptr;
+	}
+
+	data->Image = owner;
+	data->StringChars = chars;
+	data->StringCache.resize( data->StringEntries.size() );
+	data->StringCreated.assign( data->StringEntries.size(), false );
+	if( !ScenarioBinary::Validate( *data ) ) return nullptr;
+	return data;
+}
+//---------------------------------------------------------------------------
+std::shared_ptr<ScenarioData> ScenarioImage::Open( const std::shared_ptr<const void>& owner, const tjs_uint8* buffer, size_t size, tjs_uint64 sourceHash, tjs_uint64 settingsHash ) {
+	if( !IsImage( buffer, size ) ) return nullptr;
+	Header header;
+	memcpy( &header, buffer, sizeof( header ) );
+	if( header.Version != Version || header.Layout != ScenarioBinary::GetLayout() || header.SectionCount != SectionCount ) return nullptr;
+	if( header.SourceHash != sourceHash || header.SettingsHash != settingsHash ) return nullptr;
+	if( size < sizeof( Header ) + sizeof( Section ) * SectionCount ) return nullptr;
+	Section sections[SectionCount];
+	memcpy( sections, buffer + sizeof( Header ), sizeof( sections ) );
+
+	RecordTable<tjs_char> chars;
+	if( !BindSection( chars, sections[Chars], buffer, size ) ) return nullptr;
+	return OpenSections( owner, sections, buffer, size, chars.data(), chars.size() );
+}
+//---------------------------------------------------------------------------
@@ -0,0 +1,81 @@
+/**
+ * メモリにマップしてそのまま参照できる解析済みシナリオのイメージ
+ *
+ * ヘッダ、セクション表に続き、各レコード配列を 8 バイト境界に揃えて格納する。
+ * 文字列は重複のない文字列表(文字領域中の位置と長さ)と UTF-16 の文字領域に分けて格納する。
+ * 開く時はレコードを復元せず、ScenarioData の各表がイメージ中の領域を直接指す。
+ * ハッシュの扱いとバイト順/レコードサイズの制限は ScenarioBinary と同じ。
+ */
+#ifndef __SCENARIO_IMAGE_H__
+#define __SCENARIO_IMAGE_H__
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+#include "tp_stub.h"
+#include "ScenarioData.h"
+#include <vector>
+#include <memory>
+
+class ScenarioImage {
+public:
+	/** 形式のバージョン、セクションやレコードの構成を変えた時は上げること */
+	static const tjs_uint32 Version = 3;
+
+	/** セクションの並び */
+	enum SectionType {
+		StringEntries = 0,
+		Chars,
+		Octets,
+		Members,
+		Commands,
+		Tags,
+		Elements,
+		Lines,
+		Pages,
+		Labels,
+		Selects,
+		Choices,
+		Texts,
+		Rubies,
+		Checkpoints,
+		Diagnostics,
+		SectionCount
+	};
+	/** ファイルの先頭 */
+	struct Header {
+		tjs_uint8 Magic[4];		// "MDKI"
+		tjs_uint32 Version;
+		tjs_uint32 Layout;		// ScenarioBinary::GetLayout
+		tjs_uint32 SectionCount;
+		tjs_uint64 SourceHash;	// 元のテキストのハッシュ
+		tjs_uint64 SettingsHash;	// 解析設定のハッシュ
+	};
+	/** ヘッダに続くセクション表の要素 */
+	struct Section {
+		tjs_uint64 Offset;	// ファイル先頭からの位置
+		tjs_uint64 Count;	// 要素数
+	};
+
+	/** イメージの形式かどうか */
+	static bool IsImage( const tjs_uint8* buffer, size_t size );
+	/** 内部表現をイメージにして out に書き込む */
+	static void Write( const ScenarioData& data, tjs_uint64 sourceHash, tjs_uint64 settingsHash, std::vector<tjs_uint8>& out );
+	/**
+	 * 文字領域以外のセクションを out の末尾に追加し、base からの位置を sections に設定する
+	 * strings は文字領域中の各文字列の位置と長さ
+	 */
+	static void WriteSections( const ScenarioData& data, const std::vector<StringEntry>& strings, std::vector<tjs_uint8>& out, size_t base, Section* sections );
+	/**
+	 * buffer 中のセクションと文字領域 chars を参照する内部表現を返す。壊れている時は nullptr
+	 * sections[Chars] は使わない
+	 */
+	static std::shared_ptr<ScenarioData> OpenSections( const std::shared_ptr<const void>& owner, const Section* sections, const tjs_uint8* buffer, size_t size, const tjs_char* chars, size_t charCount );
+	/**
+	 * イメージを参照する内部表現を返す。owner は返した内部表現が開放されるまで保持する
+	 * 形式が異なる/ハッシュが一致しない/壊れている時は nullptr を返す
+	 */
+	static std::shared_ptr<ScenarioData> Open( const std::shared_ptr<const void>& owner, const tjs_uint8* buffer, size_t size, tjs_uint64 sourceHash, tjs_uint64 settingsHash );
+};
+
+#endif // __SCENARIO_IMAGE_H__
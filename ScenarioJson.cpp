@@ -0,0 +1,483 @@
+
+#include "ScenarioJson.h"
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <unordered_map>
+
+//---------------------------------------------------------------------------
+namespace {
+const char HexDigits[] = "0123456789abcdef";
+/** 整数で指定された時に固定のフィールドに格納する属性名、TimingType の順 */
+const tjs_char* const TimingNames[] = { TJS_W( "time" ), TJS_W( "wait" ), TJS_W( "fade" ) };
+const char* const TimingKeys[] = { "time", "wait", "fade" };
+} // namespace
+//---------------------------------------------------------------------------
+ScenarioJson::ScenarioJson( tTJSBinaryStream* stream, const ScenarioData& data, const ScenarioOption& option )
+	: Stream( stream ), Data( data ), Option( option ) {
+	Data.CreateEntries( Option, Entries );
+	Buffer.reserve( FlushSize + 16 );
+}
+//---------------------------------------------------------------------------
+void ScenarioJson::Flush() {
+	if( Buffer.empty() ) return;
+	Stream->WriteBuffer( Buffer.data(), static_cast<tjs_uint>( Buffer.size() ) );
+	Buffer.clear();
+}
+//---------------------------------------------------------------------------
+void ScenarioJson::Put( const char* str ) {
+	while( *str ) Put( *str++ );
+}
+//---------------------------------------------------------------------------
+void ScenarioJson::PutInteger( tjs_int64 value ) {
+	char buf[32];
+	snprintf( buf, sizeof( buf ), "%lld", static_cast<long long>( value ) );
+	Put( buf );
+}
+//---------------------------------------------------------------------------
+void ScenarioJson::PutReal( tjs_real value ) {
+	// NaN/Infinity は JSON で表せない
+	if( !isfinite( value ) ) {
+		Put( "null" );
+		return;
+	}
+	char buf[32];
+	snprintf( buf, sizeof( buf ), "%.17g", value );
+	Put( buf );
+}
+//---------------------------------------------------------------------------
+void ScenarioJson::PutString( const tjs_char* str, tjs_int length ) {
+	Put( '"' );
+	for( tjs_int i = 0; i < length; i++ ) {
+		tjs_uint32 c = static_cast<tjs_uint32>( str[i] );
+		if( c >= 0xD800 && c < 0xDC00 && i + 1 < length ) {
+			tjs_uint32 low = static_cast<tjs_uint32>( str[i + 1] );
+			if( low >= 0xDC00 && low < 0xE000 ) {
+				c = 0x10000 + ( ( c - 0xD800 ) << 10 ) + ( low - 0xDC00 );
+				i++;
+			}
+		}
+		// 対になっていないサロゲートは置換文字にする
+		if( c >= 0xD800 && c < 0xE000 ) c = 0xFFFD;
+
+		switch( c ) {
+		case '"': Put( "\\\"" ); break;
+		case '\\': Put( "\\\\" ); break;
+		case '\b': Put( "\\b" ); break;
+		case '\f': Put( "\\f" ); break;
+		case '\n': Put( "\\n" ); break;
+		case '\r': Put( "\\r" ); break;
+		case '\t': Put( "\\t" ); break;
+		default:
+			if( c < 0x20 ) {
+				Put( "\\u00" );
+				Put( HexDigits[c >> 4] );
+				Put( HexDigits[c & 0xf] );
+			} else if( c < 0x80 ) {
+				Put( static_cast<char>( c ) );
+			} else if( c < 0x800 ) {
+				Put( static_cast<char>( 0xC0 | ( c >> 6 ) ) );
+				Put( static_cast<char>( 0x80 | ( c & 0x3F ) ) );
+			} else if( c < 0x10000 ) {
+				Put( static_cast<char>( 0xE0 | ( c >> 12 ) ) );
+				Put( static_cast<char>( 0x80 | ( ( c >> 6 ) & 0x3F ) ) );
+				Put( static_cast<char>( 0x80 | ( c & 0x3F ) ) );
+			} else {
+				Put( static_cast<char>( 0xF0 | ( c >> 18 ) ) );
+				Put( static_cast<char>( 0x80 | ( ( c >> 12 ) & 0x3F ) ) );
+				Put( static_cast<char>( 0x80 | ( ( c >> 6 ) & 0x3F ) ) );
+				Put( static_cast<char>( 0x80 | ( c & 0x3F ) ) );
+			}
+			break;
+		}
+	}
+	Put( '"' );
+}
+//---------------------------------------------------------------------------
+void ScenarioJson::PutKey( const char* name, bool& first ) {
+	if( !first ) Put( ',' );
+	first = false;
+	Put( '"' );
+	Put( name );
+	Put( "\":" );
+}
+//---------------------------------------------------------------------------
+void ScenarioJson::PutKey( tjs_uint32 index, bool& first ) {
+	if( !first ) Put( ',' );
+	first = false;
+	PutString( index );
+	Put( ':' );
+}
+//---------------------------------------------------------------------------
+void ScenarioJson::WriteValue( const ValueRecord& value ) {
+	bool first = true;
+	switch( static_cast<ValueType>( value.Type ) ) {
+	case ValueType::Integer:
+		PutInteger( value.Data );
+		break;
+	case ValueType::Real: {
+		tjs_real d;
+		memcpy( &d, &value.Data, sizeof( d ) );
+		PutReal( d );
+		break;
+	}
+	case ValueType::String:
+		PutString( value.Index );
+		break;
+	case ValueType::Octet: {
+		Put( '{' );
+		PutKey( "octet", first );
+		Put( '"' );
+		const tjs_uint8* octet = Data.Octets.data() + value.Index;
+		for( tjs_int64 i = 0; i < value.Data; i++ ) {
+			Put( HexDigits[octet[i] >> 4] );
+			Put( HexDigits[octet[i] & 0xf] );
+		}
+		Put( "\"}" );
+		break;
+	}
+	case ValueType::Reference:
+		Put( '{' );
+		PutKey( "ref", first );
+		PutString( value.Index );
+		Put( '}' );
+		break;
+	case ValueType::FileProperty:
+		Put( '{' );
+		PutKey( "file", first );
+		PutString( value.Index );
+		PutKey( "prop", first );
+		PutString( static_cast<tjs_uint32>( value.Data ) );
+		Put( '}' );
+		break;
+	default:
+		Put( "null" );
+		break;
+	}
+}
+//---------------------------------------------------------------------------
+bool ScenarioJson::IsOverwritten( const TagRecord& tag, tjs_uint32 member ) const {
+	const MemberRecord& rec = Data.Members[tag.MemberBegin + member];
+	for( tjs_uint32 i = member + 1; i < tag.MemberCount; i++ ) {
+		const MemberRecord& later = Data.Members[tag.MemberBegin + i];
+		if( later.Target == rec.Target && later.Name == rec.Name ) return true;
+	}
+	if( tag.TimingMask ) {
+		MemberTarget timingTarget = Option.TimingFields ? MemberTarget::Field : MemberTarget::Attribute;
+		if( static_cast<MemberTarget>( rec.Target ) != timingTarget ) return false;
+		const ttstr& name = Data.GetString( rec.Name );
+		for( int i = 0; i < static_cast<int>( TimingType::Count ); i++ ) {
+			if( ( tag.TimingMask & ( 1U << i ) ) && TJS_strcmp( name.c_str(), TimingNames[i] ) == 0 ) return true;
+		}
+	}
+	return false;
+}
+//---------------------------------------------------------------------------
+void ScenarioJson::WriteMembers( const TagRecord& tag, MemberTarget target, bool& first ) {
+	for( tjs_uint32 i = 0; i < tag.MemberCount; i++ ) {
+		const MemberRecord& member = Data.Members[tag.MemberBegin + i];
+		if( static_cast<MemberTarget>( member.Target ) != target || IsOverwritten( tag, i ) ) continue;
+		PutKey( member.Name, first );
+		WriteValue( member.Value );
+	}
+}
+//---------------------------------------------------------------------------
+void ScenarioJson::WriteTimings( const TagRecord& tag, bool& first ) {
+	for( int i = 0; i < static_cast<int>( TimingType::Count ); i++ ) {
+		if( tag.TimingMask & ( 1U << i ) ) {
+			PutKey( TimingKeys[i], first );
+			PutInteger( tag.Timings[i] );
+		}
+	}
+}
+//---------------------------------------------------------------------------
+void ScenarioJson::WriteTag( tjs_uint32 index ) {
+	const TagRecord& tag = Data.Tags[index];
+	bool first = true;
+	Put( '{' );
+	if( tag.Name != ScenarioData::NoString ) {
+		PutKey( "tag", first );
+		PutString( tag.Name );
+	}
+	if( tag.Id >= 0 ) {
+		PutKey( "id", first );
+		PutInteger( tag.Id );
+	}
+	WriteMembers( tag, MemberTarget::Field, first );
+
+	bool hasAttribute = tag.TimingMask && !Option.TimingFields;
+	bool hasParameter = false;
+	for( tjs_uint32 i = 0; i < tag.MemberCount; i++ ) {
+		MemberTarget target = static_cast<MemberTarget>( Data.Members[tag.MemberBegin + i].Target );
+		if( target == MemberTarget::Attribute ) hasAttribute = true;
+		if( target == MemberTarget::Parameter ) hasParameter = true;
+	}
+	if( hasAttribute ) {
+		PutKey( "attribute", first );
+		bool firstMember = true;
+		Put( '{' );
+		WriteMembers( tag, MemberTarget::Attribute, firstMember );
+		if( !Option.TimingFields ) WriteTimings( tag, firstMember );
+		Put( '}' );
+	}
+	if( hasParameter ) {
+		PutKey( "parameter", first );
+		bool firstMember = true;
+		Put( '{' );
+		WriteMembers( tag, MemberTarget::Parameter, firstMember );
+		Put( '}' );
+	}
+	if( Option.TimingFields ) WriteTimings( tag, first );
+
+	tjs_uint32 commandBegin = tag.CommandBegin;
+	tjs_uint32 commandCount = tag.CommandCount;
+	if( Option.SignBits && tag.Signs ) {
+		PutKey( "sign", first );
+		PutInteger( tag.Signs );
+		commandBegin += tag.SignCount;
+		commandCount -= tag.SignCount;
+	}
+	if( commandCount ) {
+		PutKey( "command", first );
+		Put( '[' );
+		for( tjs_uint32 i = 0; i < commandCount; i++ ) {
+			if( i ) Put( ',' );
+			PutString( Data.Commands[commandBegin + i] );
+		}
+		Put( ']' );
+	}
+	Put( '}' );
+}
+//---------------------------------------------------------------------------
+void ScenarioJson::WriteLine( tjs_int line ) {
+	const LineRecord& rec = Data.Lines[line];
+	switch( static_cast<LineType>( rec.Type ) ) {
+	case LineType::Empty:
+		Put( '0' );
+		break;
+	case LineType::Tag:
+		WriteTag( rec.Index );
+		break;
+	case LineType::Elements:
+		Put( '[' );
+		for( tjs_uint32 i = 0; i < rec.Count; i++ ) {
+			if( i ) Put( ',' );
+			const ElementRecord& element = Data.Elements[rec.Index + i];
+			if( static_cast<ElementType>( element.Type ) == ElementType::Text ) {
+				PutString( element.Index );
+			} else {
+				WriteTag( element.Index );
+			}
+		}
+		Put( ']' );
+		break;
+	default:
+		Put( "null" );
+		break;
+	}
+}
+//---------------------------------------------------------------------------
+void ScenarioJson::WriteEntry( const LineEntry& entry ) {
+	if( entry.BlankCount > 0 ) {
+		PutInteger( Option.CompactLines ? entry.BlankCount : 0 );
+	} else {
+		WriteLine( entry.Line );
+	}
+}
+//---------------------------------------------------------------------------
+void ScenarioJson::WriteLines() {
+	Put( '[' );
+	for( size_t i = 0; i < Entries.size(); i++ ) {
+		if( i ) Put( ',' );
+		WriteEntry( Entries[i] );
+	}
+	Put( ']' );
+}
+//---------------------------------------------------------------------------
+void ScenarioJson::WritePages() {
+	Put( '[' );
+	for( tjs_uint32 i = 0; i < Data.Pages.size(); i++ ) {
+		if( i ) Put( ',' );
+		Put( '[' );
+		PutInteger( ScenarioData::FindEntry( Entries, static_cast<tjs_int>( Data.Pages[i].Begin ), Option ) );
+		Put( ',' );
+		PutInteger( ScenarioData::FindEntry( Entries, static_cast<tjs_int>( Data.Pages[i].End ), Option ) );
+		Put( ']' );
+	}
+	Put( ']' );
+}
+//---------------------------------------------------------------------------
+void ScenarioJson::WriteLabels() {
+	// 同じ名前のラベルは辞書と同じく後のものを残す
+	std::unordered_map<tjs_uint32, tjs_uint32> last;
+	for( tjs_uint32 i = 0; i < Data.Labels.size(); i++ ) {
+		last[Data.Labels[i].Name] = i;
+	}
+	bool first = true;
+	Put( '{' );
+	for( tjs_uint32 i = 0; i < Data.Labels.size(); i++ ) {
+		const LabelRecord& label = Data.Labels[i];
+		if( last[label.Name] != i ) continue;
+		PutKey( label.Name, first );
+		bool firstMember = true;
+		Put( '{' );
+		PutKey( "line", firstMember );
+		PutInteger( ScenarioData::FindEntry( Entries, static_cast<tjs_int>( label.Line ), Option ) );
+		if( label.Description != ScenarioData::NoString ) {
+			PutKey( "description", firstMember );
+			PutString( label.Description );
+		}
+		Put( '}' );
+	}
+	Put( '}' );
+}
+//---------------------------------------------------------------------------
+void ScenarioJson::WriteSelects() {
+	Put( '[' );
+	for( tjs_uint32 i = 0; i < Data.Selects.size(); i++ ) {
+		const SelectRecord& select = Data.Selects[i];
+		if( i ) Put( ',' );
+		bool first = true;
+		Put( '{' );
+		PutKey( "line", first );
+		PutInteger( ScenarioData::FindEntry( Entries, static_cast<tjs_int>( select.Line ), Option ) );
+		PutKey( "end", first );
+		PutInteger( ScenarioData::FindEntry( Entries, static_cast<tjs_int>( select.End ), Option ) );
+		PutKey( "choices", first );
+		Put( '[' );
+		for( tjs_uint32 c = 0; c < select.ChoiceCount; c++ ) {
+			if( c ) Put( ',' );
+			WriteTag( Data.Choices[select.ChoiceBegin + c] );
+		}
+		Put( ']' );
+		if( select.Option != ScenarioData::NoTag ) {
+			PutKey( "selopt", first );
+			WriteTag( select.Option );
+		}
+		Put( '}' );
+	}
+	Put( ']' );
+}
+//---------------------------------------------------------------------------
+const TextRecord* ScenarioJson::NextText( tjs_uint32& next, tjs_int entry ) const {
+	// Texts は行順なので lines と並べて進める。同じ要素になるものは辞書と同じく後のもの
+	const TextRecord* text = nullptr;
+	while( next < Data.Texts.size() ) {
+		tjs_int found = ScenarioData::FindEntry( Entries, static_cast<tjs_int>( Data.Texts[next].Line ), Option );
+		if( found > entry ) break;
+		if( found == entry ) text = &Data.Texts[next];
+		next++;
+	}
+	return text;
+}
+//---------------------------------------------------------------------------
+void ScenarioJson::WriteTexts() {
+	tjs_uint32 t = 0;
+	Put( '[' );
+	for( size_t i = 0; i < Entries.size(); i++ ) {
+		if( i ) Put( ',' );
+		const TextRecord* text = NextText( t, static_cast<tjs_int>( i ) );
+		if( text ) {
+			PutString( text->Text );
+		} else {
+			Put( "null" );
+		}
+	}
+	Put( ']' );
+}
+//---------------------------------------------------------------------------
+void ScenarioJson::WriteReadings() {
+	tjs_uint32 t = 0;
+	Put( '[' );
+	for( size_t i = 0; i < Entries.size(); i++ ) {
+		if( i ) Put( ',' );
+		const TextRecord* text = NextText( t, static_cast<tjs_int>( i ) );
+		if( !text || !text->RubyCount ) {
+			Put( "null" );
+			continue;
+		}
+		// 親文字の開始位置, 長さ, 読み を順に並べる
+		Put( '[' );
+		for( tjs_uint32 r = 0; r < text->RubyCount; r++ ) {
+			const RubyRecord& ruby = Data.Rubies[text->RubyBegin + r];
+			if( r ) Put( ',' );
+			PutInteger( ruby.Begin );
+			Put( ',' );
+			PutInteger( ruby.Length );
+			Put( ',' );
+			if( ruby.Reading != ScenarioData::NoString ) {
+				PutString( ruby.Reading );
+			} else {
+				Put( "null" );
+			}
+		}
+		Put( ']' );
+	}
+	Put( ']' );
+}
+//---------------------------------------------------------------------------
+void ScenarioJson::WriteCheckpoints() {
+	Put( '[' );
+	for( tjs_uint32 i = 0; i < Data.Checkpoints.size(); i++ ) {
+		const CheckpointRecord& checkpoint = Data.Checkpoints[i];
+		if( i ) Put( ',' );
+		bool first = true;
+		Put( '{' );
+		PutKey( "line", first );
+		PutInteger( checkpoint.Line );
+		if( checkpoint.Flags & static_cast<tjs_uint32>( LineStateFlag::HasSelectLine ) ) {
+			PutKey( "selectLine", first );
+			Put( '1' );
+		}
+		if( checkpoint.FixTagName != ScenarioData::NoString ) {
+			PutKey( "fixTagName", first );
+			PutString( checkpoint.FixTagName );
+		}
+		Put( '}' );
+	}
+	Put( ']' );
+}
+//---------------------------------------------------------------------------
+void ScenarioJson::WriteLineNumbers() {
+	Put( '[' );
+	for( size_t i = 0; i < Entries.size(); i++ ) {
+		if( i ) Put( ',' );
+		PutInteger( Entries[i].Line );
+	}
+	Put( ']' );
+}
+//---------------------------------------------------------------------------
+void ScenarioJson::WriteScenario() {
+	bool first = true;
+	Put( '{' );
+	PutKey( "lines", first );
+	WriteLines();
+	PutKey( "pages", first );
+	WritePages();
+	PutKey( "labels", first );
+	WriteLabels();
+	PutKey( "selects", first );
+	WriteSelects();
+	if( Option.PlainText ) {
+		PutKey( "texts", first );
+		WriteTexts();
+		PutKey( "readings", first );
+		WriteReadings();
+	}
+	if( !Data.Checkpoints.empty() ) {
+		PutKey( "checkpoints", first );
+		WriteCheckpoints();
+	}
+	if( Option.CompactLines ) {
+		PutKey( "lineNumbers", first );
+		WriteLineNumbers();
+	}
+	Put( "}\n" );
+}
+//---------------------------------------------------------------------------
+void ScenarioJson::Write( const ScenarioData& data, const ScenarioOption& option, tTJSBinaryStream* stream ) {
+	ScenarioJson json( stream, data, option );
+	json.WriteScenario();
+	json.Flush();
+}
+//---------------------------------------------------------------------------
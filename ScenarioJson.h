@@ -0,0 +1,78 @@
+/**
+ * 解析済みシナリオの内部表現を JSON で書き出す
+ *
+ * 辞書/配列を生成せず、レコードから直接 UTF-8 の JSON をストリームに書き出す。
+ * 構成と名前は loadScenario の結果の辞書と同じ(lines/pages/labels/selects 等)。
+ * TJS2 の辞書で表していた値は次のように書き出す。
+ *   void の行/値、null : null
+ *   オクテット列 : { "octet" : "16進数の文字列" }
+ *   %[ ref : "name" ] / %[ file : "name", prop : "name" ] : 同じ構成のオブジェクト
+ * 同じ名前の属性やラベルが複数ある時は、辞書と同じく後のものを書き出す。
+ */
+#ifndef __SCENARIO_JSON_H__
+#define __SCENARIO_JSON_H__
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+#include "tp_stub.h"
+#include "ScenarioData.h"
+#include <vector>
+
+class ScenarioJson {
+	tTJSBinaryStream* Stream;
+	const ScenarioData& Data;
+	const ScenarioOption& Option;
+	std::vector<LineEntry> Entries;
+	// ストリームへ書き出す前にためておく
+	std::vector<tjs_uint8> Buffer;
+
+	ScenarioJson( tTJSBinaryStream* stream, const ScenarioData& data, const ScenarioOption& option );
+
+	void Flush();
+	void Put( char c ) {
+		Buffer.push_back( static_cast<tjs_uint8>( c ) );
+		if( Buffer.size() >= FlushSize ) Flush();
+	}
+	void Put( const char* str );
+	void PutInteger( tjs_int64 value );
+	void PutReal( tjs_real value );
+	/** 文字列を引用符で囲み、エスケープして UTF-8 で書き出す */
+	void PutString( const tjs_char* str, tjs_int length );
+	void PutString( const ttstr& str ) { PutString( str.c_str(), str.GetLen() ); }
+	void PutString( tjs_uint32 index ) { PutString( Data.GetString( index ) ); }
+	/** オブジェクトのメンバー名を書き出す。first が false の時は前に , を置く */
+	void PutKey( const char* name, bool& first );
+	void PutKey( tjs_uint32 index, bool& first );
+
+	void WriteValue( const ValueRecord& value );
+	/** 同じ格納先に同じ名前のメンバーが後にある時、またはタイミングの値で上書きされる時は書き出さない */
+	bool IsOverwritten( const TagRecord& tag, tjs_uint32 member ) const;
+	void WriteMembers( const TagRecord& tag, MemberTarget target, bool& first );
+	void WriteTimings( const TagRecord& tag, bool& first );
+	void WriteTag( tjs_uint32 index );
+	void WriteLine( tjs_int line );
+	void WriteEntry( const LineEntry& entry );
+	void WriteLines();
+	void WritePages();
+	void WriteLabels();
+	void WriteSelects();
+	/** lines の entry 番目の要素の表示テキストを返す。next は Texts の次に調べる位置 */
+	const TextRecord* NextText( tjs_uint32& next, tjs_int entry ) const;
+	void WriteTexts();
+	void WriteReadings();
+	void WriteCheckpoints();
+	void WriteLineNumbers();
+	void WriteScenario();
+
+public:
+	/** この量がたまったらストリームへ書き出す */
+	static const size_t FlushSize = 64 * 1024;
+
+	/** 内部表現を JSON にしてストリームに書き出す */
+	static void Write( const ScenarioData& data, const ScenarioOption& option, tTJSBinaryStream* stream );
+	/** シナリオに対応する JSON のファイル名 */
+	static ttstr GetJsonName( const ttstr& storage ) { return storage + TJS_W( ".json" ); }
+};
+
+#endif // __SCENARIO_JSON_H__
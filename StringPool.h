@@ -0,0 +1,55 @@
+/**
+ * 解析結果に格納する文字列を共有するためのプール
+ * 同じ内容の文字列は同じ ttstr (tTJSVariantString) を参照する
+ */
+#ifndef __STRING_POOL_H__
+#define __STRING_POOL_H__
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+#include "tp_stub.h"
+#include <unordered_set>
+
+class StringPool {
+	struct Hash {
+		size_t operator()( const ttstr& str ) const {
+			// FNV-1a
+			size_t h = static_cast<size_t>( 2166136261U );
+			const tjs_char* p = str.c_str();
+			for( tjs_int i = str.GetLen(); i > 0; i--, p++ ) {
+				h ^= static_cast<size_t>( *p );
+				h *= static_cast<size_t>( 16777619U );
+			}
+			return h;
+		}
+	};
+	std::unordered_set<ttstr, Hash> Strings;
+	// Clear しても残す文字列
+	std::unordered_set<ttstr, Hash> Permanent;
+
+public:
+	/**
+	 * 常にプールに存在する文字列を登録し、プール内の文字列を返す
+	 * 予約語を登録しておくと、字句抽出器のシンボルと同じ ttstr になる
+	 */
+	const ttstr& AddPermanent( const ttstr& str ) {
+		const ttstr& pooled = Intern( str );
+		Permanent.insert( pooled );
+		return pooled;
+	}
+	/** 同じ内容の文字列があればそれを、なければ追加して返す */
+	const ttstr& Intern( const ttstr& str ) {
+		return *Strings.insert( str ).first;
+	}
+	void Clear() {
+		Strings = Permanent;
+	}
+	/** 常駐させる文字列の登録をすべて解除する。プール内の文字列は次の Clear まで残る */
+	void ClearPermanent() {
+		Permanent.clear();
+	}
+	tjs_uint GetCount() const { return static_cast<tjs_uint>( Strings.size() ); }
+};
+
+#endif // __STRING_POOL_H__
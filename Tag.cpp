@@ -0,0 +1,21 @@
+
+#include "Tag.h"
+#include "ScenarioDictionary.h"
+
+//---------------------------------------------------------------------------
+void Tag::release() {
+	if( owner_ ) {
+		owner_->commitTag( index_, *this );
+		owner_ = nullptr;
+	}
+	members_.clear();
+	commands_.clear();
+	signs_ = 0;
+	sign_count_ = 0;
+	timing_mask_ = 0;
+	name_.Clear();
+	has_name_ = false;
+	created_ = false;
+	index_ = 0;
+}
+//---------------------------------------------------------------------------
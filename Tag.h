@@ -1,5 +1,9 @@
 /**
- * タグを構成する辞書クラスを管理する
+ * タグを構成する要素を管理する
+ * 解析中の要素はここに保持しておき、開放時にシナリオの内部表現へ書き込む
+ *
+ * 属性/パラメータ名は予約語か字句抽出器のシンボルで、どちらも Parser の文字列プールで
+ * 同じ内容なら同じ tTJSVariantString となっているので、存在確認はポインタの比較のみで行う
  */
 #ifndef __TAG_H__
 #define __TAG_H__
@@ -9,82 +13,111 @@
 #endif
 #include "tp_stub.h"
 #include "ReservedWord.h"
+#include "ScenarioData.h"
+#include <vector>
+#include <limits>
 
 class Tag {
-	iTJSDispatch2* dic_ = nullptr;			// dictionary
-	iTJSDispatch2* attribute_ = nullptr;	// dictionary
-	iTJSDispatch2* parameter_ = nullptr;	// dictionary
-	iTJSDispatch2* command_ = nullptr;		// array
-	tjs_int command_count_ = 0;
+public:
+	/** 値の種類 */
+	enum class ValueKind {
+		Value,			// 値そのまま
+		Reference,		// 参照 value に参照名
+		FileProperty,	// ファイルプロパティ value にファイル名、prop にプロパティ名
+	};
+	/** 属性/パラメータ/タグに直接設定する値 */
+	struct Member {
+		MemberTarget target;
+		ttstr name;
+		ValueKind kind;
+		tTJSVariant value;
+		ttstr prop;
+	};
+
+private:
+	bool created_ = false;
+	bool has_name_ = false;
+	ttstr name_;
+	std::vector<Member> members_;
+	std::vector<ttstr> commands_;
+	tjs_uint32 signs_ = 0;			// 記号コマンドのビット
+	tjs_uint32 sign_count_ = 0;		// commands_ の先頭から何個が signs_ で表せるか
+	// 整数で指定された time/wait/fade 属性
+	tjs_uint32 timing_mask_ = 0;
+	tjs_int32 timings_[static_cast<int>( TimingType::Count )];
+
+	// 追加先のシナリオとタグ番号
+	class ScenarioDictionary* owner_ = nullptr;
+	tjs_uint32 index_ = 0;
+
+	friend class ScenarioDictionary;
+
+	Member* findMember( MemberTarget target, const tTJSVariantString* name ) {
+		for( auto& member : members_ ) {
+			if( member.target == target && member.name.AsVariantStringNoAddRef() == name ) return &member;
+		}
+		return nullptr;
+	}
+	/** 値を設定する
+	 * @return true 再設定/false 新規追加
+	 */
+	bool setMember( MemberTarget target, const tTJSVariantString* name, ValueKind kind, const tTJSVariant& value, const ttstr& prop = ttstr() ) {
+		created_ = true;
+		if( target == MemberTarget::Attribute ) {
+			int slot = timingSlot( name );
+			if( slot >= 0 && ( timing_mask_ & ( 1U << slot ) ) ) {
+				// 固定フィールドにある値を通常の属性に移す
+				timing_mask_ &= ~( 1U << slot );
+				members_.push_back( Member{ target, ttstr( name ), ValueKind::Value, tTJSVariant( static_cast<tTVInteger>( timings_[slot] ) ), ttstr() } );
+			}
+		}
+		Member* member = findMember( target, name );
+		if( member ) {
+			member->kind = kind;
+			member->value = value;
+			member->prop = prop;
+			return true;
+		}
+		members_.push_back( Member{ target, ttstr( name ), kind, value, prop } );
+		return false;
+	}
+
+	/** time/wait/fade の時はその番号を、それ以外は -1 を返す */
+	static int timingSlot( const tTJSVariantString* name ) {
+		if( name == GetRWord()->time() ) return static_cast<int>( TimingType::Time );
+		if( name == GetRWord()->wait() ) return static_cast<int>( TimingType::Wait );
+		if( name == GetRWord()->fade() ) return static_cast<int>( TimingType::Fade );
+		return -1;
+	}
 
 public:
 	Tag() {}
 	Tag( const tTJSVariantString* name ) {
-		dic_ = TJSCreateDictionaryObject();
-		tTJSVariant tag( *name );
-		dic_->PropSetByVS( TJS_MEMBERENSURE, GetRWord()->tag(), &tag, dic_ );
+		setTagName( name );
 	}
-	Tag( iTJSDispatch2 * dic ) : dic_( dic ) {}
 	~Tag() {
 		release();
 	}
-	/** 各要素を開放する */
-	void release() {
-		if( attribute_ ) {
-			attribute_->Release();
-			attribute_ = nullptr;
-		}
-		if( parameter_ ) {
-			parameter_->Release();
-			parameter_ = nullptr;
-		}
-		if( command_ ) {
-			command_->Release();
-			command_ = nullptr;
-		}
-		if( dic_ ) {
-			dic_->Release();
-			dic_ = nullptr;
-		}
-		command_count_ = 0;
-	}
-	/** 辞書を生成する */
-	void createDic() {
-		if( !dic_ ) {
-			dic_ = TJSCreateDictionaryObject();
-		}
-	}
-	/** 属性を生成する */
-	void createAttribute() {
-		createDic();
-		if( !attribute_ ) {
-			attribute_ = TJSCreateDictionaryObject();
-			tTJSVariant tmp( attribute_, attribute_ );
-			dic_->PropSetByVS( TJS_MEMBERENSURE, GetRWord()->attribute(), &tmp, dic_ );
-		}
-	}
-	/** パラメータを生成する */
-	void createParameter() {
-		createDic();
-		if( !parameter_ ) {
-			parameter_ = TJSCreateDictionaryObject();
-			tTJSVariant tmp( parameter_, parameter_ );
-			dic_->PropSetByVS( TJS_MEMBERENSURE, GetRWord()->parameter(), &tmp, dic_ );
-		}
+	/** 各要素を開放する。シナリオに追加済みの時は内容を書き込む */
+	void release();
+	/** 既にシナリオに追加されているタグを埋める時に使う。開放時にそのタグに書き込まれる */
+	void bind( class ScenarioDictionary* owner, tjs_uint32 index ) {
+		release();
+		created_ = true;
+		owner_ = owner;
+		index_ = index;
 	}
-	/** コマンドを生成する */
-	void createCommand() {
-		createDic();
-		if( !command_ ) {
-			command_ = TJSCreateArrayObject();
-			tTJSVariant tmp( command_, command_ );
-			dic_->PropSetByVS( TJS_MEMBERENSURE, GetRWord()->command(), &tmp, dic_ );
-		}
+
+	/** タグを生成する */
+	void create() {
+		created_ = true;
 	}
+	/** タグが生成されているか */
+	bool isCreated() const { return created_; }
+
 	/** 指定した名前で値を設定する */
 	void setValue( const tTJSVariantString* name, const tTJSVariant& val ) {
-		createDic();
-		dic_->PropSetByVS( TJS_MEMBERENSURE, const_cast<tTJSVariantString*>( name ), &val, dic_ );
+		setMember( MemberTarget::Field, name, ValueKind::Value, val );
 	}
 	/** 指定した名前で文字列を設定する */
 	void setText( const tTJSVariantString* name, const ttstr& txt ) {
@@ -93,98 +126,69 @@ public:
 	}
 	/** タグ名を設定する */
 	void setTagName( const tTJSVariantString* name ) {
-		createDic();
-		tTJSVariant val( *name );
-		setValue( GetRWord()->tag(), val );
+		created_ = true;
+		has_name_ = true;
+		name_ = ttstr( name );
 	}
 	/** タグ名が設定されているかチェックする */
-	bool existTagName() {
-		if( dic_ ) {
-			tTJSVariant v;
-			tjs_error hr = dic_->PropGet( TJS_MEMBERMUSTEXIST, GetRWord()->tag_.c_str(), nullptr, &v, dic_ );
-			return ( hr != TJS_E_MEMBERNOTFOUND );
-		} else {
-			return false;
-		}
+	bool existTagName() const {
+		return has_name_;
 	}
 	/** 属性を設定する
 	 * @return true 再設定/false 新規追加
 	 */
 	bool setAttribute(const tTJSVariantString* name, const tTJSVariant& value ) {
-		bool exist = isExistAttribute( *name );
-		createAttribute();
-		attribute_->PropSetByVS( TJS_MEMBERENSURE, const_cast<tTJSVariantString*>(name), &value, attribute_ );
-		return exist;
+		int slot = timingSlot( name );
+		if( slot >= 0 && value.Type() == tvtInteger && !findMember( MemberTarget::Attribute, name ) ) {
+			tTVInteger v = value.AsInteger();
+			if( v >= std::numeric_limits<tjs_int32>::min() && v <= std::numeric_limits<tjs_int32>::max() ) {
+				created_ = true;
+				bool exist = ( timing_mask_ & ( 1U << slot ) ) != 0;
+				timing_mask_ |= 1U << slot;
+				timings_[slot] = static_cast<tjs_int32>( v );
+				return exist;
+			}
+		}
+		return setMember( MemberTarget::Attribute, name, ValueKind::Value, value );
 	}
 	/** パラメータを設定する
 	 * @return true 再設定/false 新規追加
 	 */
 	bool setParameter(const tTJSVariantString* name, const tTJSVariant& value ) {
-		bool exist = isExistParameter( *name );
-		createParameter();
-		parameter_->PropSetByVS( TJS_MEMBERENSURE, const_cast<tTJSVariantString*>(name), &value, parameter_ );
-		return exist;
+		return setMember( MemberTarget::Parameter, name, ValueKind::Value, value );
 	}
 	/** ファイルプロパティを属性かパラメータに設定する */
-	bool setFileProperty( const tTJSVariantString* name, const tTJSVariantString* file, const tTJSVariantString* prop, bool isparam ) {
-		iTJSDispatch2* dic = TJSCreateDictionaryObject();
-		tTJSVariant vfile( *file );
-		dic->PropSetByVS( TJS_MEMBERENSURE, GetRWord()->file(), &vfile, dic );
-		tTJSVariant vprop( *prop );
-		dic->PropSetByVS( TJS_MEMBERENSURE, GetRWord()->prop(), &vprop, dic );
-		tTJSVariant tmp( dic, dic );
-		dic->Release();
-		if( isparam ) {
-			return setParameter( name, tmp );
-		} else {
-			return setAttribute( name, tmp );
-		}
+	bool setFileProperty( const tTJSVariantString* name, const tTJSVariant& file, const ttstr& prop, bool isparam ) {
+		return setMember( isparam ? MemberTarget::Parameter : MemberTarget::Attribute, name, ValueKind::FileProperty, file, prop );
 	}
 	/** 参照を属性かパラメータに設定する */
-	bool setReference( const tTJSVariantString* name, const tTJSVariantString* ref, bool isparam ) {
-		iTJSDispatch2* dic = TJSCreateDictionaryObject();
-		tTJSVariant vref( *ref );
-		dic->PropSetByVS( TJS_MEMBERENSURE, GetRWord()->ref(), &vref, dic );
-		tTJSVariant tmp( dic, dic );
-		dic->Release();
-		if( isparam ) {
-			return setParameter( name, tmp );
-		} else {
-			return setAttribute( name, tmp );
-		}
+	bool setReference( const tTJSVariantString* name, const tTJSVariant& ref, bool isparam ) {
+		return setMember( isparam ? MemberTarget::Parameter : MemberTarget::Attribute, name, ValueKind::Reference, ref );
 	}
 	/** コマンドを追加する */
 	void addCommand( const tTJSVariantString* name ) {
-		createCommand();
-		tTJSVariant val( *name );
-		command_->PropSetByNum( TJS_MEMBERENSURE, command_count_, &val, command_ );
-		command_count_++;
+		created_ = true;
+		commands_.push_back( ttstr( name ) );
+	}
+	/** 記号で指定されたコマンドを追加する */
+	void addSignCommand( const tTJSVariantString* name, tjs_uint32 bit ) {
+		if( bit && sign_count_ == commands_.size() ) {
+			signs_ |= bit;
+			sign_count_++;
+		}
+		addCommand( name );
 	}
 	/** 指定された名前の属性が存在するかチェックする */
-	bool isExistAttribute( const tjs_char* name ) {
-		if( attribute_ ) {
-			tTJSVariant v;
-			tjs_error hr = attribute_->PropGet( TJS_MEMBERMUSTEXIST, name, nullptr, &v, attribute_ );
-			return ( hr != TJS_E_MEMBERNOTFOUND );
-		} else {
-			return false;
-		}
+	bool isExistAttribute( const tTJSVariantString* name ) {
+		int slot = timingSlot( name );
+		if( slot >= 0 && ( timing_mask_ & ( 1U << slot ) ) ) return true;
+		return findMember( MemberTarget::Attribute, name ) != nullptr;
 	}
 	/** 指定された名前のパラメータが存在するかチェックする */
-	bool isExistParameter( const tjs_char* name ) {
-		if( parameter_ ) {
-			tTJSVariant v;
-			tjs_error hr = parameter_->PropGet( TJS_MEMBERMUSTEXIST, name, nullptr, &v, parameter_ );
-			return ( hr != TJS_E_MEMBERNOTFOUND );
-		} else {
-			return false;
-		}
+	bool isExistParameter( const tTJSVariantString* name ) {
+		return findMember( MemberTarget::Parameter, name ) != nullptr;
 	}
-
-	/** タグとなる辞書を取得する */
-	iTJSDispatch2* getTag() { return dic_; }
 };
 
 
 #endif // __TAG_H__
-